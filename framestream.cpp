@@ -0,0 +1,159 @@
+/**
+ * Frame streams: netpbm or bare frames written to a file descriptor without
+ * going through stdio.
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "framestream.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+FrameStream::FrameStream(int fd, StreamFormat format) : fd_(fd), owned_(false), format_(format), good_(fd >= 0),
+    width_(0), height_(0), bytespp_(0), header_(), iov_()
+{
+}
+
+FrameStream::FrameStream(const char *filename, StreamFormat format) : fd_(-1), owned_(false), format_(format), 
+    good_(false), width_(0), height_(0), bytespp_(0), header_(), iov_()
+{
+    if (!strcmp(filename, "-"))
+    {
+        fd_ = STDOUT_FILENO;
+    }
+    else
+    {
+        fd_ = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        owned_ = fd_ >= 0;
+    }
+    good_ = fd_ >= 0;
+    if (!good_)
+    {
+        std::cerr << "can't open file " << filename << "\n";
+    }
+}
+
+FrameStream::~FrameStream()
+{
+    if (owned_)
+    {
+        close(fd_);
+    }
+}
+
+bool FrameStream::good()
+{
+    return good_;
+}
+
+// builds the header of frames of this size, the same for every one of them
+bool FrameStream::build_header(int width, int height, int bytespp)
+{
+    char text[160];
+    int length = 0;
+    if (format_ == STREAM_PPM)
+    {
+        if (bytespp != 1 && bytespp != 3)
+        {
+            std::cerr << "ppm frames can't hold " << bytespp << " channels, use pam\n";
+            return false;
+        }
+        length = snprintf(text, sizeof(text), "P%d\n%d %d\n255\n", bytespp == 1 ? 5 : 6, width, height);
+    }
+    else if (format_ == STREAM_PAM)
+    {
+        const char *tupltype = bytespp == 1 ? "GRAYSCALE" : bytespp == 3 ? "RGB" : bytespp == 4 ? "RGB_ALPHA" : NULL;
+        if (!tupltype)
+        {
+            std::cerr << "pam frames can't hold " << bytespp << " channels\n";
+            return false;
+        }
+        length = snprintf(text, sizeof(text), "P7\nWIDTH %d\nHEIGHT %d\nDEPTH %d\nMAXVAL 255\nTUPLTYPE %s\nENDHDR\n",
+            width, height, bytespp, tupltype);
+    }
+    header_.assign(text, text + length);
+    width_ = width;
+    height_ = height;
+    bytespp_ = bytespp;
+    return true;
+}
+
+// writes everything iov_ points to, IOV_MAX pieces at a time, picking up
+// after short writes
+bool FrameStream::write_all()
+{
+    size_t i = 0;
+    while (i < iov_.size())
+    {
+        int n = (int)std::min(iov_.size() - i, (size_t)IOV_MAX);
+        ssize_t written = writev(fd_, &iov_[i], n);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            std::cerr << "can't write frame: " << strerror(errno) << "\n";
+            good_ = false;
+            return false;
+        }
+        while (i < iov_.size() && (size_t)written >= iov_[i].iov_len)
+        {
+            written -= iov_[i].iov_len;
+            i++;
+        }
+        if (written > 0)
+        {
+            iov_[i].iov_base = (char *)iov_[i].iov_base + written;
+            iov_[i].iov_len -= written;
+        }
+    }
+    return true;
+}
+
+bool FrameStream::write(TGAImage &image, bool flip)
+{
+    unsigned char *data = image.buffer();
+    int width = image.get_width();
+    int height = image.get_height();
+    int bytespp = image.get_bytespp();
+    if (!good_ || !data)
+    {
+        return false;
+    }
+    if ((width != width_ || height != height_ || bytespp != bytespp_) && !build_header(width, height, bytespp))
+    {
+        good_ = false;
+        return false;
+    }
+
+    iov_.clear();
+    if (!header_.empty())
+    {
+        struct iovec header = {&header_[0], header_.size()};
+        iov_.push_back(header);
+    }
+    size_t row = (size_t)width * bytespp;
+    if (flip)
+    {
+        for (int y = height - 1; y >= 0; y--)
+        {
+            struct iovec line = {data + y * row, row};
+            iov_.push_back(line);
+        }
+    }
+    else
+    {
+        struct iovec pixels = {data, height * row};
+        iov_.push_back(pixels);
+    }
+    return write_all();
+}
@@ -0,0 +1,58 @@
+/**
+ * Header file for streaming uncompressed frames to a file descriptor, such
+ * as stdout or a named pipe read by a video encoder.
+ */
+
+#ifndef __FRAMESTREAM_H__
+#define __FRAMESTREAM_H__
+
+#include <vector>
+#include <sys/uio.h>
+#include "tgaimage.h"
+
+// how each frame is framed in the stream
+enum StreamFormat
+{
+    STREAM_RAW,  // the pixels only, the reader has to know the size and channels
+    STREAM_PPM,  // a netpbm P6 (rgb) or P5 (grayscale) image per frame, no alpha
+    STREAM_PAM   // a netpbm P7 image per frame, any number of channels
+};
+
+// writes images straight from their buffers with unbuffered writev calls,
+// one or a few per frame; the header is built once and only rebuilt when a
+// frame of another size or channel count comes along. channels go out in
+// buffer order, which is what the TGAColor constructors call r, g, b (and
+// a), while images read from tga files hold b, g, r
+class FrameStream
+{
+private:
+    int fd_;
+    bool owned_;  // opened here, closed by the destructor
+    StreamFormat format_;
+    bool good_;
+    int width_;
+    int height_;
+    int bytespp_;
+    std::vector<char> header_;
+    std::vector<struct iovec> iov_;
+    bool build_header(int width, int height, int bytespp);
+    bool write_all();
+    FrameStream(const FrameStream &);
+    FrameStream &operator=(const FrameStream &);
+public:
+    // writes to fd, which is left open
+    FrameStream(int fd, StreamFormat format = STREAM_PAM);
+
+    // opens filename for writing, "-" being stdout; opening a named pipe
+    // waits for its reader
+    FrameStream(const char *filename, StreamFormat format = STREAM_PAM);
+    ~FrameStream();
+    bool good();
+
+    // appends the image as the next frame; rows are written last first
+    // unless flip is false, so an image with its origin at the bottom left,
+    // as rendered, comes out upright. a failed write leaves the stream bad
+    bool write(TGAImage &image, bool flip = true);
+};
+
+#endif //__FRAMESTREAM_H__
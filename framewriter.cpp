@@ -0,0 +1,106 @@
+/**
+ * The frame writer: a bounded queue of finished frames and the thread that
+ * drains it.
+ */
+
+#include <utility>
+#include "framewriter.h"
+
+FrameWriter::FrameWriter(int depth) : mutex_(), ready_(), space_(), queue_(), depth_(depth > 0 ? depth : 1), 
+    busy_(false), stop_(false), failed_(0), thread_()
+{
+    thread_ = std::thread(&FrameWriter::run, this);
+}
+
+FrameWriter::~FrameWriter()
+{
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    ready_.notify_all();
+    thread_.join();
+}
+
+void FrameWriter::submit(TGAImage &&image, const std::string &filename, bool flip)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_.wait(lock, [this] { return (int)queue_.size() < depth_; });
+    queue_.push_back(Frame());
+    queue_.back().image = std::move(image);
+    queue_.back().filename = filename;
+    queue_.back().stream = NULL;
+    queue_.back().flip = flip;
+    lock.unlock();
+    ready_.notify_one();
+}
+
+void FrameWriter::submit(TGAImage &&image, FrameStream &stream, bool flip)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_.wait(lock, [this] { return (int)queue_.size() < depth_; });
+    queue_.push_back(Frame());
+    queue_.back().image = std::move(image);
+    queue_.back().stream = &stream;
+    queue_.back().flip = flip;
+    lock.unlock();
+    ready_.notify_one();
+}
+
+bool FrameWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_.wait(lock, [this] { return queue_.empty() && !busy_; });
+    bool ok = failed_ == 0;
+    failed_ = 0;
+    return ok;
+}
+
+// writes queued frames one at a time until the writer stops
+void FrameWriter::run()
+{
+    for (;;)
+    {
+        Frame frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty())
+            {
+                return;
+            }
+            frame.image = std::move(queue_.front().image);
+            frame.filename.swap(queue_.front().filename);
+            frame.stream = queue_.front().stream;
+            frame.flip = queue_.front().flip;
+            queue_.pop_front();
+            busy_ = true;
+        }
+        space_.notify_all();
+
+        // streams write the rows in flipped order themselves
+        bool ok;
+        if (frame.stream)
+        {
+            ok = frame.stream->write(frame.image, frame.flip);
+        }
+        else
+        {
+            if (frame.flip)
+            {
+                frame.image.flip_vertically();
+            }
+            ok = frame.image.write_tga_file(frame.filename.c_str());
+        }
+
+        // the image goes back to its allocator before the frame counts as done
+        frame.image = TGAImage();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            busy_ = false;
+            failed_ += !ok;
+        }
+        space_.notify_all();
+    }
+}
@@ -0,0 +1,67 @@
+/**
+ * Header file for writing finished frames to disk on a background thread.
+ */
+
+#ifndef __FRAMEWRITER_H__
+#define __FRAMEWRITER_H__
+
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "tgaimage.h"
+#include "framestream.h"
+
+// how many finished frames may wait for the writer before submit() blocks;
+// with the frame being written and the one being rendered that makes two
+// more buffers in flight than the renderer itself needs
+const int FRAME_QUEUE_DEPTH = 2;
+
+// flips, encodes and writes frames on its own thread, so the renderer can go
+// on with the next frame as soon as it hands one over; frames are written
+// in the order they were submitted
+class FrameWriter
+{
+private:
+    struct Frame
+    {
+        TGAImage image;
+        std::string filename;
+        FrameStream *stream;  // written to instead of filename if not NULL
+        bool flip;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable ready_;  // a frame was queued, or the writer stops
+    std::condition_variable space_;  // a frame left the queue or was written
+    std::deque<Frame> queue_;
+    int depth_;
+    bool busy_;   // a frame is being written
+    bool stop_;
+    int failed_;  // frames that could not be written since the last flush
+    std::thread thread_;
+    void run();
+    FrameWriter(const FrameWriter &);
+    FrameWriter &operator=(const FrameWriter &);
+public:
+    FrameWriter(int depth = FRAME_QUEUE_DEPTH);
+
+    // writes what is still queued before returning
+    ~FrameWriter();
+
+    // takes over a finished image to be written to filename as an rle tga,
+    // flipped first to a top-left origin unless flip is false; blocks while
+    // depth frames are already waiting, may be called from any thread
+    void submit(TGAImage &&image, const std::string &filename, bool flip = true);
+
+    // the same for the next frame of a stream, which has to stay open until
+    // the frame is flushed; see FrameStream::write()
+    void submit(TGAImage &&image, FrameStream &stream, bool flip = true);
+
+    // waits until every frame submitted so far is written, returns false if
+    // any of them could not be written since the last flush
+    bool flush();
+};
+
+#endif //__FRAMEWRITER_H__
@@ -0,0 +1,171 @@
+/**
+ * Integer Bresenham line drawing with clipping, and wireframe rendering.
+ */
+
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+#include "line.h"
+
+// rounds a / b towards negative infinity (b > 0)
+static long long floor_div(long long a, long long b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// the line below steps along x with n(k) = ceil((2dy * k - dx) / 2dx) y steps
+// after k pixels; returns the first k with n(k) >= n
+static long long first_step_with(long long n, long long dx, long long dy)
+{
+    return floor_div(2 * dx * (n - 1) + dx, 2 * dy) + 1;
+}
+
+// returns the last k with n(k) <= n
+static long long last_step_with(long long n, long long dx, long long dy)
+{
+    return floor_div(2 * dx * n + dx, 2 * dy);
+}
+
+void line(int x0, int y0, int x1, int y1, TGAImage &image, TGAColor color)
+{
+    int width = image.get_width();
+    int height = image.get_height();
+    int bytespp = image.get_bytespp();
+    if (!image.buffer())
+    {
+        return;
+    }
+
+    bool steep = false;
+ 
+    // if the line is steep, transpose it
+    if (std::abs(x0 - x1) < std::abs(y0 - y1))
+    {
+        std::swap(x0, y0);
+        std::swap(x1, y1);
+        std::swap(width, height);
+        steep = true;
+    }
+ 
+    // draw image from left to right
+    if (x0 > x1)
+    {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+    }
+
+    long long dx = (long long)x1 - x0;
+    long long dy = std::abs((long long)y1 - y0);
+    int ystep = y1 > y0 ? 1 : -1;
+
+    // clip the range of steps k so that x0 + k stays inside the image ...
+    long long kmin = std::max(0LL, -(long long)x0);
+    long long kmax = std::min(dx, (long long)width - 1 - x0);
+
+    // ... and so does y0 +- n(k); n(k) never decreases, so this is a range too
+    long long nmin = ystep > 0 ? -(long long)y0 : (long long)y0 - (height - 1);
+    long long nmax = ystep > 0 ? (long long)height - 1 - y0 : y0;
+    if (dy == 0)
+    {
+        if (nmin > 0 || nmax < 0)
+        {
+            return;
+        }
+    }
+    else
+    {
+        kmin = std::max(kmin, first_step_with(nmin, dx, dy));
+        kmax = std::min(kmax, last_step_with(nmax, dx, dy));
+    }
+    if (kmin > kmax)
+    {
+        return;
+    }
+
+    // start stepping at kmin with the error term the full line would have there
+    long long n = dx == 0 ? 0 : std::max(0LL, floor_div(2 * dy * kmin - dx + 2 * dx - 1, 2 * dx));
+    long long error = 2 * dy * kmin - 2 * dx * n;  // distance from best straight line, times 2dx
+    int x = x0 + (int)kmin;
+    int y = y0 + ystep * (int)n;
+
+    // everything left is on the image, so pixels are written without checks
+    long long xoffset = steep ? (long long)height * bytespp : bytespp;
+    long long yoffset = (steep ? bytespp : (long long)width * bytespp) * ystep;
+    unsigned char *pixel = image.buffer() + (steep ? (y + (long long)x * height) : (x + (long long)y * width)) * bytespp;
+    for (long long k = kmin; k <= kmax; k++)
+    {
+        memcpy(pixel, color.rgba, bytespp);
+        pixel += xoffset;
+
+        error += 2 * dy;
+        // if the distance from the best straight line to (x1, y1) is greater than a pixel
+        if (error > dx)
+        {
+            pixel += yoffset;
+            error -= 2 * dx;
+        }
+    }
+}
+
+void line(Vec2i p0, Vec2i p1, TGAImage &image, TGAColor color)
+{
+    line(p0.x, p0.y, p1.x, p1.y, image, color);
+}
+
+// numbers every vertex of the model with the first vertex at the same
+// position, so the copies of a vertex along a uv or normal seam are one
+static std::vector<int> position_ids(const Model &model)
+{
+    ConstSpan<Vec3f> positions = model.verts();
+    std::vector<int> order(positions.size);
+    for (int v = 0; v < positions.size; v++)
+    {
+        order[v] = v;
+    }
+    std::stable_sort(order.begin(), order.end(), [&positions](int a, int b)
+    {
+        return memcmp(&positions[a], &positions[b], sizeof(Vec3f)) < 0;
+    });
+
+    std::vector<int> ids(positions.size);
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        bool same = i && !memcmp(&positions[order[i]], &positions[order[i - 1]], sizeof(Vec3f));
+        ids[order[i]] = same ? ids[order[i - 1]] : order[i];
+    }
+    return ids;
+}
+
+void draw_wireframe(const Model &model, const std::vector<ScreenVertex> &verts, TGAImage &image, TGAColor color)
+{
+    // each edge as (smaller vertex index, larger vertex index) packed into
+    // one number, so sorting puts the copies of shared edges next to each
+    // other; edges along seams are keyed by position so they count once too
+    std::vector<int> ids = position_ids(model);
+    std::vector<unsigned long long> edges;
+    for (int i = 0; i < model.nfaces(); i++)
+    {
+        Vec3i face = model.face(i);
+        for (int j = 0; j < 3; j++)
+        {
+            unsigned long long a = (unsigned int)ids[face[j]];
+            unsigned long long b = (unsigned int)ids[face[(j + 1) % 3]];
+            edges.push_back(a < b ? (a << 32 | b) : (b << 32 | a));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    for (size_t i = 0; i < edges.size(); i++)
+    {
+        // clip against the near plane and guard band first, so the
+        // coordinates are sure to fit in an int
+        Vec3f a, b;
+        if (clip_segment(verts[edges[i] >> 32], verts[edges[i] & 0xffffffff], image.get_width(), 
+            image.get_height(), a, b))
+        {
+            line((int)std::floor(a.x), (int)std::floor(a.y), (int)std::floor(b.x), (int)std::floor(b.y), 
+                image, color);
+        }
+    }
+}
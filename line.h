@@ -0,0 +1,24 @@
+/**
+ * Header file for line drawing.
+ */
+
+#ifndef __LINE_H__
+#define __LINE_H__
+
+#include <vector>
+#include "tgaimage.h"
+#include "geometry.h"
+#include "model.h"
+#include "pipeline.h"
+
+// draws a line with Bresenham's algorithm; the part outside the image is
+// clipped away before stepping, and the pixels that are left are the same
+// ones an unclipped line would draw
+void line(int x0, int y0, int x1, int y1, TGAImage &image, TGAColor color);
+void line(Vec2i p0, Vec2i p1, TGAImage &image, TGAColor color);
+
+// draws every edge of the model once, with the vertices already through the
+// vertex stage (see transform_vertices())
+void draw_wireframe(const Model &model, const std::vector<ScreenVertex> &verts, TGAImage &image, TGAColor color);
+
+#endif //__LINE_H__
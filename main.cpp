@@ -1,182 +1,156 @@
+#include <iostream>
 #include <utility>
 #include <cmath>
 #include <vector>
 #include <algorithm>
 #include <limits>
+#include <string.h>
+#include <stdlib.h>
 #include "tgaimage.h"
 #include "model.h"
 #include "geometry.h"
+#include "rasterizer.h"
+#include "pipeline.h"
+#include "line.h"
+#include "meshstream.h"
+#include "texture.h"
+#include "render.h"
+#include "threadpool.h"
+#include "framestream.h"
+#include "framewriter.h"
 
 const TGAColor white = TGAColor(255, 255, 255, 255);
 const TGAColor red   = TGAColor(255, 0,   0,   255);
 const TGAColor green = TGAColor(0,   255, 0,   255);
 const TGAColor blue  = TGAColor(0,   0,   255, 255);
-Model *model = NULL;
 const int width  = 800;
 const int height = 800;
 const float EPSILON = 0.001;
 
-void line(Vec2i vec1, Vec2i vec2, TGAImage &image, TGAColor color)
+// draws pixels onto image 
+void rasterize(Vec2i p0, Vec2i p1, TGAImage &image, TGAColor color, int* ybuffer)
 {
-    bool steep = false;
-    // if the line is steep, transpose it
-    if (std::abs(vec1.x - vec2.x) < std::abs(vec1.y - vec2.y))
-    {
-        std::swap(vec1.x, vec1.y);
-        std::swap(vec2.x, vec2.y);
-        steep = true;
-    }
-    // draw image from left to right
-    if (vec1.x > vec2.x)
+    // go from left to right
+    if (p0.x > p1.x)
     {
-        std::swap(vec1.x, vec2.x);
-        std::swap(vec1.y, vec2.y);
+        std::swap(p0, p1);
     }
-    
-    int dx = vec2.x - vec1.x;
-    int dy = vec2.y - vec1.y;
-    float derror = std::abs(dy / float(dx));
-    float error = 0;  // distance from best straight line to current pixel
-    int y = vec1.y;                        
-       
-    for (int x = vec1.x; x <= vec2.x; x++)
+
+    for (int x = p0.x; x <= p1.x; x++)
     {
-        if (steep)
-        {
-            image.set(y, x, color);  // de-transpose image
-        }
-        else
-        {
-            image.set(x, y, color);
-        }
-        
-        error += derror;
-        // if the distance from the best straight line to (vec2.x, vec2.y) is greater than a pixel
-        if (error > .5)
+        float t = (x - p0.x) / (float)(p1.x - p0.x);
+        int y = p0.y * (1. - t) + p1.y * t;
+
+        // if the pixel we're trying to draw on image is closer to
+        // the camera, draw this pixel instead
+        if (ybuffer[x] < y)
         {
-            y += (vec2.y > vec1.y ? 1 : -1);
-            error -= 1.0;
+            ybuffer[x] = y;
+            image.set(x, 0, color);
         }
-        
     }
 }
 
-void line(int x0, int y0, int x1, int y1, TGAImage &image, TGAColor color)
+// places n copies of the model on a square grid that fills the image, each
+// turned a little further and colored in turn
+std::vector<Instance> grid_instances(int n)
 {
-     bool steep = false;
- 
-     // if the line is steep, transpose it
-     if (std::abs(x0 - x1) < std::abs(y0 - y1))
-     {
-         std::swap(x0, y0);
-         std::swap(x1, y1);
-         steep = true;
-     }
- 
-     // draw image from left to right
-     if (x0 > x1)
-     {
-         std::swap(x0, x1);
-         std::swap(y0, y1);
-     }
-     
-     int dx = x1 - x0;
-     int dy = y1 - y0;
-     float derror = std::abs(dy / float(dx));
-     float error = 0;  // distance from best straight line to current pixel
-     int y = y0;                               
-     for (int x = x0; x <= x1; x++)
-     {
-         if (steep)
-         {
-             image.set(y, x, color);  // de-transpose image
-         }
-         else
-         {
-             image.set(x, y, color);
-         }
-         
-         error += derror;
-         // if the distance from the best straight line to (x1, y1) is greater than a pixel
-         if (error > .5)
-         {
-             y += (y1 > y0 ? 1 : -1);
-             error -= 1.0;
-         }
+    const TGAColor colors[] = {white, red, green, blue};
+    int side = (int)std::ceil(std::sqrt((float)n));
+    std::vector<Instance> instances(n);
+    for (int i = 0; i < n; i++)
+    {
+        Matrix m = rotation_y(0.3f * i);
+        for (int j = 0; j < 3; j++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                m[j][k] /= side;
+            }
+        }
+        m[0][3] = -1 + (2 * (i % side) + 1) / (float)side;
+        m[1][3] = -1 + (2 * (i / side) + 1) / (float)side;
+        instances[i].transform = m;
+        instances[i].color = colors[i % 4];
     }
+    return instances;
 }
 
-// computes the barycentric coordinates of a point
-Vec3f barycentric(Vec2i *pts, Vec2i P) { 
+// the camera of frame k of n of the model turning once around the y axis
+Camera turntable_view(const Camera &camera, int k, int n)
+{
+    Matrix turn = rotation_y(2 * M_PI * k / n);
+    Camera view;
+    view.transform = camera.transform * turn;
+    view.light = proj<3>(turn.transpose() * embed<4>(camera.light, 0.f));
+    return view;
+}
 
-    // take the cross product of these two vectors
-    Vec3f u = Vec3f(pts[2].x - pts[0].x, pts[1].x - pts[0].x, pts[0].x - P.x) ^
-                Vec3f(pts[2].y - pts[0].y, pts[1].y - pts[0].y, pts[0].y - P.y);
-    
-    // triangle is not formed correctly
-    if (std::abs(u.z)<1) 
+// renders n frames of the model turning once around the y axis to
+// frame000.tga and on; the frames are rendered at the same time, one
+// thread each, and handed to writer as they are done, later frames reuse the
+// buffers of frames already written
+void render_turntable(const Model &model, const Camera &camera, RenderOptions options, int n, FrameWriter &writer)
+{
+    options.nthreads = 1;
+    TGAPool buffers;
+    default_thread_pool().parallel_for(n, [&](int k)
     {
-        return Vec3f(-1,1,1);
-    }
-
-    return Vec3f(1.f -(u.x + u.y) / u.z, u.y / u.z, u.x / u.z); 
-} 
- 
-void triangle(Vec2i *pts, TGAImage &image, TGAColor color) 
-{ 
-    Vec2i bboxmin(image.get_width() - 1, image.get_height() - 1); 
-    Vec2i bboxmax(0, 0); 
-    Vec2i clamp(image.get_width() - 1, image.get_height() - 1); 
+        TGAImage image(width, height, TGAImage::RGB, &buffers);
+        ZBuffer zbuffer(width, height);
+        render(model, turntable_view(camera, k, n), image, zbuffer, options);
 
-    // goes through triangle vertices to determine dimensions of bounding box
-    for (int i = 0; i < 3; i++) 
-    { 
-        for (int j = 0; j < 2; j++) 
-        { 
-            bboxmin.raw[j] = std::max(0, std::min(bboxmin.raw[j], pts[i].raw[j])); 
-            bboxmax.raw[j] = std::min(clamp.raw[j], std::max(bboxmax.raw[j], pts[i].raw[j])); 
-        } 
-    } 
+        char name[32];
+        snprintf(name, sizeof(name), "frame%03d.tga", k);
+        writer.submit(std::move(image), name);
+    });
 
-    Vec2i P; 
-    for (P.x = bboxmin.x; P.x <= bboxmax.x; P.x++) 
-    { 
-        for (P.y = bboxmin.y; P.y <= bboxmax.y; P.y++) 
-        { 
-            Vec3f bc_screen  = barycentric(pts, P); 
-
-            // negative barycentric coordinates mean that the pixel is not in bounding box
-            if (bc_screen.x < 0 || bc_screen.y < 0 || bc_screen.z < 0) 
-            {
-                continue; 
-            }
+    // the queued frames still hold buffers of the pool
+    writer.flush();
+}
 
-            image.set(P.x, P.y, color); 
-        } 
-    } 
-} 
- 
-// draws pixels onto image 
-void rasterize(Vec2i p0, Vec2i p1, TGAImage &image, TGAColor color, int* ybuffer)
+// renders the same frames one after the other, each with every core, and
+// sends them to stream in order; the writer sends one frame while the next
+// is rendered
+void stream_turntable(const Model &model, const Camera &camera, const RenderOptions &options, int n,
+    FrameStream &stream, FrameWriter &writer)
 {
-    // go from left to right
-    if (p0.x > p1.x)
+    TGAPool buffers;
+    for (int k = 0; k < n; k++)
     {
-        std::swap(p0, p1);
+        TGAImage image(width, height, TGAImage::RGB, &buffers);
+        ZBuffer zbuffer(width, height);
+        render(model, turntable_view(camera, k, n), image, zbuffer, options);
+        writer.submit(std::move(image), stream);
     }
+    writer.flush();
+}
 
-    for (int x = p0.x; x <= p1.x; x++)
+// draws the model chunk by chunk as it is read, lit the same way as render();
+// each chunk is rasterized before the next one is read
+void render_stream(const char *filename, size_t memory, const Matrix &transform, Vec3f lightDir, 
+    TGAImage &image, ZBuffer &zbuffer)
+{
+    MeshStream stream(filename, memory);
+    Rasterizer rasterizer(image, zbuffer);
+    MeshChunk chunk;
+    std::vector<ScreenVertex> verts;
+    while (stream.next(chunk))
     {
-        float t = (x - p0.x) / (float)(p1.x - p0.x);
-        int y = p0.y * (1. - t) + p1.y * t;
-
-        // if the pixel we're trying to draw on image is closer to
-        // the camera, draw this pixel instead
-        if (ybuffer[x] < y)
+        verts.resize(chunk.verts.size());
+        transform_vertices(chunk.verts.data(), transform, width, height, verts.data(), 0, (int)verts.size());
+        for (size_t i = 0; i < chunk.indices.size(); i += 3)
         {
-            ybuffer[x] = y;
-            image.set(x, 0, color);
+            const uint32_t *f = &chunk.indices[i];
+            Vec3f n = cross(chunk.verts[f[2]] - chunk.verts[f[0]], chunk.verts[f[1]] - chunk.verts[f[0]]);
+            float intensity = n.normalize() * lightDir;
+            if (intensity > 0)
+            {
+                draw_triangle(rasterizer, verts[f[0]], verts[f[1]], verts[f[2]], 
+                    TGAColor(intensity * 255, intensity * 255, intensity * 255, 255)); 
+            }
         }
+        rasterizer.flush();
     }
 }
 
@@ -193,8 +167,9 @@ int main(int argc, char** argv)
     // screen line behind the triangles
     line(Vec2i(10, 10), Vec2i(790, 10), scene, white);
 
-    scene.flip_vertically();
-    scene.write_tga_file("output.tga");
+    // frames are written in the order they are submitted
+    FrameWriter writer;
+    writer.submit(std::move(scene), "output.tga");
 
     TGAImage render(width, 16, TGAImage::RGB);
 
@@ -209,48 +184,166 @@ int main(int argc, char** argv)
     rasterize(Vec2i(120, 434), Vec2i(444, 400), render, green, ybuffer);
     rasterize(Vec2i(330, 463), Vec2i(594, 200), render, blue,  ybuffer);
 
-    exit(0);
-
-    if (argc == 2)
+    // -vbuffer rasterizes triangle ids first and shades each pixel once afterwards,
+    // -wireframe only draws the edges of the model, -meshlets culls clusters
+    // of faces before looking at single ones, -stream draws the model a chunk
+    // at a time within -memory megabytes instead of loading it, -lod draws
+    // the coarsest level of detail that looks the same at the model's size
+    // on screen, which -zoom scales, and -texture maps a tga file onto the
+    // model in the shading pass of -vbuffer; -instances draws that many
+    // copies of the model in one pass, and -frames renders a turntable of
+    // that many frames in parallel; -pam, -ppm and -raw send the frames (or
+    // the one image) uncompressed and in order to a file, pipe or stdout
+    // ("-") instead, for a video encoder to read
+    const char *filename = "obj/african_head.obj";
+    const char *texturename = NULL;
+    bool deferred = false;
+    bool wireframe = false;
+    bool streaming = false;
+    int ninstances = 0;
+    int nframes = 0;
+    const char *streamname = NULL;
+    StreamFormat format = STREAM_PAM;
+    int flags = 0;
+    size_t memory = 64;
+    float zoom = 1;
+    for (int i = 1; i < argc; i++)
     {
-        model = new Model(argv[1]);
-    }
-    else
-    {
-        model = new Model("obj/african_head.obj");
+        if (!strcmp(argv[i], "-vbuffer"))
+        {
+            deferred = true;
+        }
+        else if (!strcmp(argv[i], "-wireframe"))
+        {
+            wireframe = true;
+        }
+        else if (!strcmp(argv[i], "-meshlets"))
+        {
+            flags |= MODEL_MESHLETS;
+        }
+        else if (!strcmp(argv[i], "-lod"))
+        {
+            flags |= MODEL_LODS;
+        }
+        else if (!strcmp(argv[i], "-zoom") && i + 1 < argc)
+        {
+            zoom = atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-texture") && i + 1 < argc)
+        {
+            texturename = argv[++i];
+            deferred = true;
+        }
+        else if (!strcmp(argv[i], "-instances") && i + 1 < argc)
+        {
+            ninstances = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-frames") && i + 1 < argc)
+        {
+            nframes = atoi(argv[++i]);
+        }
+        else if ((!strcmp(argv[i], "-pam") || !strcmp(argv[i], "-ppm") || !strcmp(argv[i], "-raw")) && i + 1 < argc)
+        {
+            format = !strcmp(argv[i], "-pam") ? STREAM_PAM : !strcmp(argv[i], "-ppm") ? STREAM_PPM : STREAM_RAW;
+            streamname = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-stream"))
+        {
+            streaming = true;
+        }
+        else if (!strcmp(argv[i], "-memory") && i + 1 < argc)
+        {
+            memory = atol(argv[++i]);
+        }
+        else
+        {
+            filename = argv[i];
+        }
     }
 
     TGAImage image(width, height, TGAImage::RGB);
     Vec3f lightDir(0,0,-1); // the direction the light is coming from
 
-    for (int i = 0; i < model->nfaces(); i++) 
-    { 
-        std::vector<int> face = model->face(i); 
-        Vec3f worldCoords[3];  // regular coordinates
-        Vec2i screenCoords[3]; // coordinates scaled to screen dimensions
-    
-        for (int j = 0; j < 3; j++) 
-        { 
-            Vec3f v = model->vert(face[j]);
-            screenCoords[j] = Vec2i((v.x + 1.0) * width / 2.0, (v.y + 1.0) * height / 2.0);
-            worldCoords[j] = v;
-        } 
+    ZBuffer zbuffer(width, height);
 
-        // gets the normal vector of a triangle face
-        Vec3f n = (worldCoords[2] - worldCoords[0]) ^ (worldCoords[1] - worldCoords[0]);
-        n.normalize();
+    Matrix scale = Matrix::identity();
+    for (int i = 0; i < 3; i++)
+    {
+        scale[i][i] = zoom;
+    }
+    Camera camera;
+    camera.transform = viewport(0, 0, width, height) * projection(0) * scale;
+    camera.light = lightDir;
+    RenderOptions options;
+    options.mode = wireframe ? RENDER_WIREFRAME : deferred ? RENDER_DEFERRED : RENDER_FORWARD;
 
-        // intensity is the dot product of the light direction and normal vector of faces
-        float intensity = n * lightDir;
+    // the texture is read bottom up, like the image is written
+    TGAImage teximage;
+    Texture *texture = NULL;
+    if (texturename && teximage.read_tga_file(texturename))
+    {
+        teximage.flip_vertically();
+        texture = new Texture(teximage);
+        options.texture = texture;
+    }
 
-        if (intensity > 0)
+    Model *model = NULL;
+    if (streaming)
+    {
+        // a streamed model is never loaded, so it is only ever drawn whole,
+        // once and lit per face
+        if (deferred || wireframe || flags || ninstances > 0 || nframes > 0)
+        {
+            std::cerr << "-stream ignores -vbuffer, -wireframe, -texture, -lod, -meshlets, -instances and -frames" 
+                << std::endl;
+        }
+        render_stream(filename, memory << 20, camera.transform, lightDir, image, zbuffer);
+    }
+    else
+    {
+        model = new Model(filename, flags);
+        int level = select_lod(*model, camera.transform, options.lod_error);
+        if (level && !ninstances)
         {
-            triangle(screenCoords, image, TGAColor(intensity * 255, intensity * 255, intensity * 255, 255)); 
+            std::cerr << "# lod " << level << " f#" << model->lod_nfaces(level) << std::endl;
         }
     }
 
-    image.flip_vertically();
-    image.write_tga_file("output.tga");
+    FrameStream *stream = streamname ? new FrameStream(streamname, format) : NULL;
+    bool turntable = model && ninstances <= 0 && nframes > 0;
+    if (model && ninstances > 0)
+    {
+        Rasterizer rasterizer(image, zbuffer);
+        std::vector<Instance> instances = grid_instances(ninstances);
+        draw_instances(rasterizer, *model, camera.transform, instances.data(), ninstances, lightDir, 
+            options.lod_error);
+        rasterizer.flush();
+    }
+    else if (turntable && stream)
+    {
+        stream_turntable(*model, camera, options, nframes, *stream, writer);
+    }
+    else if (turntable)
+    {
+        render_turntable(*model, camera, options, nframes, writer);
+    }
+    else if (model)
+    {
+        ::render(*model, camera, image, zbuffer, options);
+    }
+
+    // a turntable writes its own frames and leaves image blank
+    if (!turntable && stream)
+    {
+        writer.submit(std::move(image), *stream);
+    }
+    else if (!turntable)
+    {
+        writer.submit(std::move(image), "output.tga");
+    }
+    writer.flush();
+    delete stream;
     delete model;
+    delete texture;
     return 0;
 }
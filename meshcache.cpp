@@ -0,0 +1,130 @@
+/**
+ * A compact binary copy of a parsed obj file, kept next to it and mapped
+ * straight into memory on later runs.
+ */
+
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "meshcache.h"
+
+static const char MESH_CACHE_MAGIC[8] = {'T', 'R', 'M', 'E', 'S', 'H', '\0', '\0'};
+
+// arrays start at multiples of this, so they can be read in place
+const uint64_t MESH_CACHE_ALIGN = 64;
+
+std::string mesh_cache_path(const char *filename)
+{
+    return std::string(filename) + ".cache";
+}
+
+uint64_t mesh_cache_layout(MeshCacheHeader &header, const struct stat &source)
+{
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MESH_CACHE_VERSION;
+    header.source_size = source.st_size;
+    header.source_mtime = source.st_mtim.tv_sec;
+    header.source_mtime_nsec = source.st_mtim.tv_nsec;
+
+    header.sizes[CACHE_VERTS] = 12ull * header.nverts;
+    header.sizes[CACHE_UVS] = 8ull * header.nuvs;
+    header.sizes[CACHE_NORMALS] = 12ull * header.nnormals;
+    header.sizes[CACHE_INDICES] = 3ull * header.index_bytes * header.nfaces;
+    header.sizes[CACHE_FACE_NORMALS] = 12ull * header.nfaces;
+
+    uint64_t offset = sizeof(MeshCacheHeader);
+    for (int i = 0; i < CACHE_NARRAYS; i++)
+    {
+        offset = (offset + MESH_CACHE_ALIGN - 1) / MESH_CACHE_ALIGN * MESH_CACHE_ALIGN;
+        header.offsets[i] = offset;
+        offset += header.sizes[i];
+    }
+    return offset;
+}
+
+int open_mesh_cache(const char *filename, const struct stat &source, MeshCacheHeader &header, size_t &size)
+{
+    std::string path = mesh_cache_path(filename);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header))
+    {
+        close(fd);
+        return -1;
+    }
+
+    // the layout is recomputed from the counts, so a damaged header cannot
+    // point outside of the file; attributes are per vertex or absent
+    MeshCacheHeader expected = header;
+    bool valid = !memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) &&
+        header.version == MESH_CACHE_VERSION && (header.index_bytes == 2 || header.index_bytes == 4) &&
+        (header.nuvs == 0 || header.nuvs == header.nverts) &&
+        (header.nnormals == 0 || header.nnormals == header.nverts) &&
+        mesh_cache_layout(expected, source) <= (uint64_t)st.st_size &&
+        !memcmp(expected.offsets, header.offsets, sizeof(expected.offsets)) &&
+        !memcmp(expected.sizes, header.sizes, sizeof(expected.sizes)) &&
+        header.source_size == expected.source_size && header.source_mtime == expected.source_mtime &&
+        header.source_mtime_nsec == expected.source_mtime_nsec;
+    if (!valid)
+    {
+        close(fd);
+        return -1;
+    }
+    size = st.st_size;
+    return fd;
+}
+
+const MeshCacheHeader *map_mesh_cache(const char *filename, const struct stat &source, size_t &size)
+{
+    MeshCacheHeader header;
+    int fd = open_mesh_cache(filename, source, header, size);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    return data == MAP_FAILED ? NULL : (const MeshCacheHeader *)data;
+}
+
+bool write_mesh_cache(const char *filename, const MeshCacheHeader &header, const void *const *arrays)
+{
+    // written to a file of its own first and renamed over the cache
+    std::string path = mesh_cache_path(filename);
+    std::string tmp = path + "." + std::to_string(getpid());
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        std::cerr << "can't write mesh cache " << path << "\n";
+        return false;
+    }
+
+    bool ok = pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+    for (int i = 0; ok && i < CACHE_NARRAYS; i++)
+    {
+        const char *p = (const char *)arrays[i];
+        for (uint64_t done = 0; ok && done < header.sizes[i]; )
+        {
+            ssize_t n = pwrite(fd, p + done, header.sizes[i] - done, header.offsets[i] + done);
+            ok = n > 0;
+            done += ok ? n : 0;
+        }
+    }
+    uint64_t size = header.offsets[CACHE_NARRAYS - 1] + header.sizes[CACHE_NARRAYS - 1];
+    ok = ok && ftruncate(fd, size) == 0;
+    ok = close(fd) == 0 && ok;
+    ok = ok && rename(tmp.c_str(), path.c_str()) == 0;
+    if (!ok)
+    {
+        unlink(tmp.c_str());
+        std::cerr << "can't write mesh cache " << path << "\n";
+    }
+    return ok;
+}
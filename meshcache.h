@@ -0,0 +1,63 @@
+/**
+ * Header file for the binary cache of parsed models.
+ */
+
+#ifndef __MESHCACHE_H__
+#define __MESHCACHE_H__
+
+#include <string>
+#include <stdint.h>
+#include <sys/stat.h>
+
+// bumped whenever the layout below changes, older caches are rebuilt
+const uint32_t MESH_CACHE_VERSION = 2;
+
+// the arrays of a cache, in the order they are stored
+enum MeshCacheArray
+{
+    CACHE_VERTS,         // Vec3f per vertex
+    CACHE_UVS,           // Vec2f per vertex, or none
+    CACHE_NORMALS,       // Vec3f per vertex, or none
+    CACHE_INDICES,       // 3 indices of index_bytes each per face
+    CACHE_FACE_NORMALS,  // Vec3f per face
+    CACHE_NARRAYS
+};
+
+// the start of a cache file, every array follows it at a 64 byte aligned offset
+struct MeshCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t index_bytes;   // 2 or 4
+    uint64_t source_size;   // size and modification time of the obj file it was made from
+    int64_t source_mtime;
+    int64_t source_mtime_nsec;
+    uint32_t nverts;
+    uint32_t nuvs;
+    uint32_t nnormals;
+    uint32_t nfaces;
+    float bounds[6];        // bounding box of the vertices, min then max
+    uint64_t offsets[CACHE_NARRAYS];
+    uint64_t sizes[CACHE_NARRAYS];
+};
+
+// the cache file that belongs to an obj file
+std::string mesh_cache_path(const char *filename);
+
+// fills in magic, version, source and the array layout from the counts and
+// index_bytes, returns the size of the whole file
+uint64_t mesh_cache_layout(MeshCacheHeader &header, const struct stat &source);
+
+// opens the cache of an obj file if it exists and was made from source as
+// it is now, reads its header and size and returns the file descriptor or -1
+int open_mesh_cache(const char *filename, const struct stat &source, MeshCacheHeader &header, size_t &size);
+
+// maps the cache of an obj file if it exists and was made from source as
+// it is now, returns its header (the arrays follow) or NULL
+const MeshCacheHeader *map_mesh_cache(const char *filename, const struct stat &source, size_t &size);
+
+// writes a cache with the given header and arrays, replacing the old one
+// at once so that concurrent readers never see half of it
+bool write_mesh_cache(const char *filename, const MeshCacheHeader &header, const void *const *arrays);
+
+#endif //__MESHCACHE_H__
@@ -0,0 +1,680 @@
+/**
+ * Load time mesh optimizations: face corners are welded into unique
+ * vertices, triangles are ordered for the post-transform vertex cache and
+ * vertices for the order in which they are fetched, and meshes are
+ * simplified into a chain of levels of detail.
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <queue>
+#include <iterator>
+#include <utility>
+#include <string.h>
+#include "meshopt.h"
+
+// the scoring of Forsyth's algorithm: the vertices of the last triangle
+// get a fixed score, the rest of the cache decays with its position, and
+// vertices with few triangles left are boosted to clear them out early
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float CACHE_DECAY_POWER = 1.5f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+// valences up to this use a table of scores
+const int MAX_VALENCE_TABLE = 32;
+
+// open edges are held in place by planes through them that weigh this
+// much more than the planes of the faces
+const double BOUNDARY_WEIGHT = 10;
+
+// collapses may not turn a face by more than about 80 degrees
+const float MAX_FLIP = 0.2f;
+
+static unsigned int hash_corner(const Vec3i &c)
+{
+    unsigned int h = (unsigned int)c.x * 0x9e3779b1u;
+    h ^= (unsigned int)c.y * 0x85ebca77u + (h << 6) + (h >> 2);
+    h ^= (unsigned int)c.z * 0xc2b2ae3du + (h << 6) + (h >> 2);
+    return h;
+}
+
+int weld_corners(const Vec3i *corners, int ncorners, uint32_t *indices, std::vector<int> &first)
+{
+    // open addressing table of vertex numbers, at most half full
+    size_t size = 1;
+    while (size < 2 * (size_t)ncorners)
+    {
+        size <<= 1;
+    }
+    std::vector<int> table(size, -1);
+    first.clear();
+
+    for (int i = 0; i < ncorners; i++)
+    {
+        const Vec3i &c = corners[i];
+        size_t slot = hash_corner(c) & (size - 1);
+        while (table[slot] >= 0)
+        {
+            const Vec3i &o = corners[first[table[slot]]];
+            if (o.x == c.x && o.y == c.y && o.z == c.z)
+            {
+                break;
+            }
+            slot = (slot + 1) & (size - 1);
+        }
+        if (table[slot] < 0)
+        {
+            table[slot] = (int)first.size();
+            first.push_back(i);
+        }
+        indices[i] = table[slot];
+    }
+    return (int)first.size();
+}
+
+// the score of a vertex at position cachepos of the cache (-1 if it is not
+// in there) that still belongs to remaining triangles
+static float vertex_score(int cachepos, int remaining, const float *cachescores, const float *valencescores)
+{
+    if (remaining == 0)
+    {
+        return -1;
+    }
+    float score = cachepos < 0 ? 0 : cachescores[cachepos];
+    if (remaining <= MAX_VALENCE_TABLE)
+    {
+        return score + valencescores[remaining];
+    }
+    return score + VALENCE_BOOST_SCALE * std::pow((float)remaining, -VALENCE_BOOST_POWER);
+}
+
+void optimize_vertex_cache(uint32_t *indices, int nfaces, int nverts)
+{
+    float cachescores[VERTEX_CACHE_SIZE];
+    for (int i = 0; i < VERTEX_CACHE_SIZE; i++)
+    {
+        cachescores[i] = i < 3 ? LAST_TRIANGLE_SCORE :
+            std::pow(1 - (i - 3) / (float)(VERTEX_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+    }
+    float valencescores[MAX_VALENCE_TABLE + 1];
+    valencescores[0] = 0;
+    for (int i = 1; i <= MAX_VALENCE_TABLE; i++)
+    {
+        valencescores[i] = VALENCE_BOOST_SCALE * std::pow((float)i, -VALENCE_BOOST_POWER);
+    }
+
+    // the triangles of every vertex that are not emitted yet are kept at
+    // the front of its range of adjacency
+    std::vector<int> start(nverts + 1, 0);
+    for (int i = 0; i < 3 * nfaces; i++)
+    {
+        start[indices[i] + 1]++;
+    }
+    for (int v = 0; v < nverts; v++)
+    {
+        start[v + 1] += start[v];
+    }
+    std::vector<int> adjacency(3 * (size_t)nfaces);
+    std::vector<int> remaining(nverts, 0);
+    for (int i = 0; i < 3 * nfaces; i++)
+    {
+        int v = indices[i];
+        adjacency[start[v] + remaining[v]++] = i / 3;
+    }
+
+    std::vector<int> cachepos(nverts, -1);
+    std::vector<float> vscore(nverts);
+    for (int v = 0; v < nverts; v++)
+    {
+        vscore[v] = vertex_score(-1, remaining[v], cachescores, valencescores);
+    }
+    std::vector<float> tscore(nfaces);
+    std::vector<bool> emitted(nfaces, false);
+    int best = -1;
+    for (int t = 0; t < nfaces; t++)
+    {
+        tscore[t] = vscore[indices[3 * t]] + vscore[indices[3 * t + 1]] + vscore[indices[3 * t + 2]];
+        if (best < 0 || tscore[t] > tscore[best])
+        {
+            best = t;
+        }
+    }
+
+    std::vector<uint32_t> output(3 * (size_t)nfaces);
+    int cache[VERTEX_CACHE_SIZE + 3];
+    int ncache = 0;
+    int cursor = 0;
+    for (int n = 0; n < nfaces; n++)
+    {
+        // nothing in the cache has triangles left, go on with the next
+        // triangle that is not emitted yet
+        if (best < 0)
+        {
+            while (emitted[cursor])
+            {
+                cursor++;
+            }
+            best = cursor;
+        }
+
+        const uint32_t *tri = indices + 3 * best;
+        std::copy(tri, tri + 3, &output[3 * n]);
+        emitted[best] = true;
+
+        // the triangle's vertices move to the front of the cache
+        int newcache[VERTEX_CACHE_SIZE + 3];
+        int nnew = 0;
+        for (int j = 0; j < 3; j++)
+        {
+            int v = tri[j];
+            newcache[nnew++] = v;
+            for (int k = start[v]; k < start[v] + remaining[v]; k++)
+            {
+                if (adjacency[k] == best)
+                {
+                    std::swap(adjacency[k], adjacency[start[v] + remaining[v] - 1]);
+                    remaining[v]--;
+                    break;
+                }
+            }
+        }
+        for (int i = 0; i < ncache; i++)
+        {
+            int v = cache[i];
+            if (v != (int)tri[0] && v != (int)tri[1] && v != (int)tri[2])
+            {
+                newcache[nnew++] = v;
+            }
+        }
+
+        // rescores the vertices that moved and the triangles around them;
+        // the ones pushed past the end of the cache fall out of it
+        best = -1;
+        for (int i = 0; i < nnew; i++)
+        {
+            int v = newcache[i];
+            cachepos[v] = i < VERTEX_CACHE_SIZE ? i : -1;
+            vscore[v] = vertex_score(cachepos[v], remaining[v], cachescores, valencescores);
+        }
+        for (int i = 0; i < nnew; i++)
+        {
+            int v = newcache[i];
+            for (int k = start[v]; k < start[v] + remaining[v]; k++)
+            {
+                int t = adjacency[k];
+                const uint32_t *o = indices + 3 * t;
+                tscore[t] = vscore[o[0]] + vscore[o[1]] + vscore[o[2]];
+                if (best < 0 || tscore[t] > tscore[best])
+                {
+                    best = t;
+                }
+            }
+        }
+        ncache = std::min(nnew, VERTEX_CACHE_SIZE);
+        std::copy(newcache, newcache + ncache, cache);
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void optimize_vertex_fetch(uint32_t *indices, int nindices, int nverts, std::vector<int> &order)
+{
+    std::vector<int> remap(nverts, -1);
+    order.clear();
+    for (int i = 0; i < nindices; i++)
+    {
+        int v = indices[i];
+        if (remap[v] < 0)
+        {
+            remap[v] = (int)order.size();
+            order.push_back(v);
+        }
+        indices[i] = remap[v];
+    }
+
+    // vertices no triangle uses go last
+    for (int v = 0; v < nverts; v++)
+    {
+        if (remap[v] < 0)
+        {
+            order.push_back(v);
+        }
+    }
+}
+
+// the sum of squared distances to a set of planes, as the upper triangle
+// of a symmetric 4x4 matrix stored row by row
+struct Quadric
+{
+    double q[10];
+};
+
+static void add_plane(Quadric &quadric, Vec3f n, float d, double weight)
+{
+    double p[4] = {n.x, n.y, n.z, d};
+    for (int i = 0, k = 0; i < 4; i++)
+    {
+        for (int j = i; j < 4; j++)
+        {
+            quadric.q[k++] += weight * p[i] * p[j];
+        }
+    }
+}
+
+static double quadric_error(const Quadric &a, const Quadric &b, Vec3f v)
+{
+    double p[4] = {v.x, v.y, v.z, 1};
+    double e = 0;
+    for (int i = 0, k = 0; i < 4; i++)
+    {
+        for (int j = i; j < 4; j++, k++)
+        {
+            e += (i == j ? 1 : 2) * (a.q[k] + b.q[k]) * p[i] * p[j];
+        }
+    }
+    return std::max(e, 0.0);
+}
+
+static unsigned int hash_position(const Vec3f &v)
+{
+    unsigned int bits[3];
+    memcpy(bits, &v.x, sizeof(bits));
+    Vec3i c(bits[0], bits[1], bits[2]);
+    return hash_corner(c);
+}
+
+// moving every corner at position from to position to; the stamps tell
+// whether either end changed since the cost was worked out
+struct Collapse
+{
+    double cost;
+    int from, to;
+    unsigned int stamp_from, stamp_to;
+
+    bool operator<(const Collapse &o) const { return cost > o.cost; }
+};
+
+// the state of a mesh being simplified: triangles keep naming the
+// vertices of the full mesh, while collapses work on positions, so the
+// copies of a vertex along a uv or normal seam move together, each to the
+// copy at the other end on its own side of the seam
+class Simplifier
+{
+private:
+    const Vec3f *positions_;
+    int nfaces_;
+    std::vector<int> position_;         // position of every vertex
+    std::vector<int> vertex_;           // first vertex at every position
+    std::vector<uint32_t> tris_;
+    std::vector<bool> alive_;
+    std::vector<std::vector<int> > adjacency_;  // triangles around every position, some dead
+    std::vector<Quadric> quadrics_;
+    std::vector<unsigned int> stamps_;
+    std::priority_queue<Collapse> queue_;
+    int ntris_;
+    double error_;
+
+    Vec3f corner(int t, int j) const { return positions_[tris_[3 * t + j]]; }
+    int at(int t, int j) const { return position_[tris_[3 * t + j]]; }
+    void neighbours(int p, std::vector<int> &out) const;
+    void push_collapses(int p);
+    bool targets(int from, int to, std::vector<std::pair<uint32_t, uint32_t> > &moves) const;
+    bool allowed(int from, int to) const;
+    void collapse(int from, int to);
+public:
+    Simplifier(const Vec3f *positions, int nverts, const uint32_t *indices, int nfaces);
+    bool reduce(int target);
+    void level(LodLevel &out) const;
+    int ntris() const { return ntris_; }
+};
+
+Simplifier::Simplifier(const Vec3f *positions, int nverts, const uint32_t *indices, int nfaces) : 
+    positions_(positions), nfaces_(nfaces), position_(nverts), vertex_(), 
+    tris_(indices, indices + 3 * (size_t)nfaces), alive_(nfaces, true), adjacency_(), quadrics_(), stamps_(), 
+    queue_(), ntris_(0), error_(0)
+{
+    // numbers the distinct positions, the same way corners are welded
+    size_t size = 1;
+    while (size < 2 * (size_t)nverts)
+    {
+        size <<= 1;
+    }
+    std::vector<int> table(size, -1);
+    for (int v = 0; v < nverts; v++)
+    {
+        size_t slot = hash_position(positions[v]) & (size - 1);
+        while (table[slot] >= 0 && memcmp(&positions[vertex_[table[slot]]], &positions[v], sizeof(Vec3f)))
+        {
+            slot = (slot + 1) & (size - 1);
+        }
+        if (table[slot] < 0)
+        {
+            table[slot] = (int)vertex_.size();
+            vertex_.push_back(v);
+        }
+        position_[v] = table[slot];
+    }
+    int npositions = (int)vertex_.size();
+    adjacency_.resize(npositions);
+    quadrics_.resize(npositions);
+    memset(quadrics_.data(), 0, npositions * sizeof(Quadric));
+    stamps_.assign(npositions, 0);
+
+    // every position starts with the planes of its faces; degenerate faces
+    // are dropped right away
+    std::vector<uint64_t> edges;
+    for (int t = 0; t < nfaces; t++)
+    {
+        int a = at(t, 0), b = at(t, 1), c = at(t, 2);
+        Vec3f n = cross(corner(t, 1) - corner(t, 0), corner(t, 2) - corner(t, 0));
+        if (a == b || b == c || c == a || !(n * n > 0))
+        {
+            alive_[t] = false;
+            continue;
+        }
+        ntris_++;
+        n.normalize();
+        for (int j = 0; j < 3; j++)
+        {
+            int p = at(t, j), q = at(t, (j + 1) % 3);
+            add_plane(quadrics_[p], n, -(n * corner(t, 0)), 1);
+            adjacency_[p].push_back(t);
+            edges.push_back((uint64_t)std::min(p, q) << 32 | std::max(p, q));
+        }
+    }
+
+    // edges with a single face are the mesh's boundary
+    std::sort(edges.begin(), edges.end());
+    for (int t = 0; t < nfaces; t++)
+    {
+        if (!alive_[t])
+        {
+            continue;
+        }
+        Vec3f n = cross(corner(t, 1) - corner(t, 0), corner(t, 2) - corner(t, 0)).normalize();
+        for (int j = 0; j < 3; j++)
+        {
+            int p = at(t, j), q = at(t, (j + 1) % 3);
+            uint64_t key = (uint64_t)std::min(p, q) << 32 | std::max(p, q);
+            if (std::upper_bound(edges.begin(), edges.end(), key) - 
+                std::lower_bound(edges.begin(), edges.end(), key) != 1)
+            {
+                continue;
+            }
+            Vec3f e = corner(t, (j + 1) % 3) - corner(t, j);
+            Vec3f side = cross(e, n);
+            if (side * side > 0)
+            {
+                side.normalize();
+                add_plane(quadrics_[p], side, -(side * corner(t, j)), BOUNDARY_WEIGHT);
+                add_plane(quadrics_[q], side, -(side * corner(t, j)), BOUNDARY_WEIGHT);
+            }
+        }
+    }
+
+    for (int p = 0; p < npositions; p++)
+    {
+        push_collapses(p);
+    }
+}
+
+// lists the positions sharing a live triangle with p
+void Simplifier::neighbours(int p, std::vector<int> &out) const
+{
+    out.clear();
+    for (size_t i = 0; i < adjacency_[p].size(); i++)
+    {
+        int t = adjacency_[p][i];
+        if (!alive_[t])
+        {
+            continue;
+        }
+        for (int j = 0; j < 3; j++)
+        {
+            if (at(t, j) != p)
+            {
+                out.push_back(at(t, j));
+            }
+        }
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+// queues the cheaper direction of every edge at p
+void Simplifier::push_collapses(int p)
+{
+    std::vector<int> around;
+    neighbours(p, around);
+    for (size_t i = 0; i < around.size(); i++)
+    {
+        int q = around[i];
+        const Vec3f &pp = positions_[vertex_[p]], &pq = positions_[vertex_[q]];
+        double to_q = quadric_error(quadrics_[p], quadrics_[q], pq);
+        double to_p = quadric_error(quadrics_[p], quadrics_[q], pp);
+        Collapse c;
+        c.cost = std::min(to_q, to_p);
+        c.from = to_q <= to_p ? p : q;
+        c.to = to_q <= to_p ? q : p;
+        c.stamp_from = stamps_[c.from];
+        c.stamp_to = stamps_[c.to];
+        queue_.push(c);
+    }
+}
+
+// pairs every vertex at from with the vertex at to that the triangles
+// dropped by the collapse give it, so moved corners keep the uv and normal
+// of their own side of a seam; fails if a vertex at from has no such
+// triangle or more than one partner, which keeps collapses that start on
+// a seam along it
+bool Simplifier::targets(int from, int to, std::vector<std::pair<uint32_t, uint32_t> > &moves) const
+{
+    moves.clear();
+    for (size_t i = 0; i < adjacency_[from].size(); i++)
+    {
+        int t = adjacency_[from][i];
+        if (!alive_[t] || (at(t, 0) != to && at(t, 1) != to && at(t, 2) != to))
+        {
+            continue;
+        }
+        uint32_t vfrom = 0, vto = 0;
+        for (int j = 0; j < 3; j++)
+        {
+            vfrom = at(t, j) == from ? tris_[3 * t + j] : vfrom;
+            vto = at(t, j) == to ? tris_[3 * t + j] : vto;
+        }
+        size_t k = 0;
+        while (k < moves.size() && moves[k].first != vfrom)
+        {
+            k++;
+        }
+        if (k == moves.size())
+        {
+            moves.push_back(std::make_pair(vfrom, vto));
+        }
+        else if (moves[k].second != vto)
+        {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < adjacency_[from].size(); i++)
+    {
+        int t = adjacency_[from][i];
+        if (!alive_[t])
+        {
+            continue;
+        }
+        for (int j = 0; j < 3; j++)
+        {
+            if (at(t, j) != from)
+            {
+                continue;
+            }
+            size_t k = 0;
+            while (k < moves.size() && moves[k].first != tris_[3 * t + j])
+            {
+                k++;
+            }
+            if (k == moves.size())
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// a collapse must keep the surface a manifold, which it does if the ends
+// only share the neighbours across their common triangles, and must not
+// fold any of the triangles that move over
+bool Simplifier::allowed(int from, int to) const
+{
+    std::vector<int> a, b, common;
+    neighbours(from, a);
+    neighbours(to, b);
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(common));
+    int shared = 0;
+    for (size_t i = 0; i < adjacency_[from].size(); i++)
+    {
+        int t = adjacency_[from][i];
+        if (!alive_[t])
+        {
+            continue;
+        }
+        int j = at(t, 0) == from ? 0 : at(t, 1) == from ? 1 : 2;
+        if (at(t, 0) == to || at(t, 1) == to || at(t, 2) == to)
+        {
+            shared++;
+            continue;
+        }
+        Vec3f v[3] = {corner(t, 0), corner(t, 1), corner(t, 2)};
+        Vec3f before = cross(v[1] - v[0], v[2] - v[0]);
+        v[j] = positions_[vertex_[to]];
+        Vec3f after = cross(v[1] - v[0], v[2] - v[0]);
+        if (!(after * after > 0) || after.normalize() * before.normalize() < MAX_FLIP)
+        {
+            return false;
+        }
+    }
+    std::vector<std::pair<uint32_t, uint32_t> > moves;
+    return shared > 0 && (int)common.size() == shared && targets(from, to, moves);
+}
+
+void Simplifier::collapse(int from, int to)
+{
+    std::vector<std::pair<uint32_t, uint32_t> > moves;
+    targets(from, to, moves);
+    for (size_t i = 0; i < adjacency_[from].size(); i++)
+    {
+        int t = adjacency_[from][i];
+        if (!alive_[t])
+        {
+            continue;
+        }
+        if (at(t, 0) == to || at(t, 1) == to || at(t, 2) == to)
+        {
+            alive_[t] = false;
+            ntris_--;
+            continue;
+        }
+        for (int j = 0; j < 3; j++)
+        {
+            for (size_t k = 0; at(t, j) == from && k < moves.size(); k++)
+            {
+                if (moves[k].first == tris_[3 * t + j])
+                {
+                    tris_[3 * t + j] = moves[k].second;
+                    break;
+                }
+            }
+        }
+        adjacency_[to].push_back(t);
+    }
+    std::vector<int>().swap(adjacency_[from]);
+    std::vector<int> &list = adjacency_[to];
+    list.erase(std::remove_if(list.begin(), list.end(), [this](int t) { return !alive_[t]; }), list.end());
+    for (int k = 0; k < 10; k++)
+    {
+        quadrics_[to].q[k] += quadrics_[from].q[k];
+    }
+    stamps_[from]++;
+    stamps_[to]++;
+    push_collapses(to);
+}
+
+// collapses the cheapest edges until at most target triangles are left,
+// returns false if it ran out of edges before
+bool Simplifier::reduce(int target)
+{
+    while (ntris_ > target)
+    {
+        if (queue_.empty())
+        {
+            return false;
+        }
+        Collapse c = queue_.top();
+        queue_.pop();
+        if (c.stamp_from != stamps_[c.from] || c.stamp_to != stamps_[c.to] || !allowed(c.from, c.to))
+        {
+            continue;
+        }
+        collapse(c.from, c.to);
+        error_ = std::max(error_, c.cost);
+    }
+    return true;
+}
+
+// copies the live triangles out with the vertices they use, numbered in
+// the order they are first used, and the error collected so far
+void Simplifier::level(LodLevel &out) const
+{
+    out.vertices.clear();
+    out.positions.clear();
+    out.indices.clear();
+    out.normals.clear();
+    std::vector<int> local(position_.size(), -1);
+    for (int t = 0; t < nfaces_; t++)
+    {
+        if (!alive_[t])
+        {
+            continue;
+        }
+        for (int j = 0; j < 3; j++)
+        {
+            uint32_t v = tris_[3 * t + j];
+            if (local[v] < 0)
+            {
+                local[v] = (int)out.vertices.size();
+                out.vertices.push_back(v);
+                out.positions.push_back(positions_[v]);
+            }
+            out.indices.push_back(local[v]);
+        }
+        Vec3f n = cross(corner(t, 2) - corner(t, 0), corner(t, 1) - corner(t, 0));
+        out.normals.push_back(n.normalize());
+    }
+    out.error = (float)std::sqrt(error_);
+}
+
+void build_lod_chain(const Vec3f *positions, int nverts, const uint32_t *indices, int nfaces, int minfaces, 
+    std::vector<LodLevel> &levels)
+{
+    levels.clear();
+    Simplifier simplifier(positions, nverts, indices, nfaces);
+    for (int target = nfaces / 2; target >= minfaces; target /= 2)
+    {
+        int before = simplifier.ntris();
+        bool reached = simplifier.reduce(target);
+        if (simplifier.ntris() == before)
+        {
+            break;
+        }
+        levels.push_back(LodLevel());
+        simplifier.level(levels.back());
+        if (!reached)
+        {
+            break;
+        }
+    }
+}
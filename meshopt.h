@@ -0,0 +1,51 @@
+/**
+ * Header file for the load time mesh optimizations: welding of face
+ * corners into vertices, reordering for the post-transform cache and
+ * simplification into levels of detail.
+ */
+
+#ifndef __MESHOPT_H__
+#define __MESHOPT_H__
+
+#include <vector>
+#include <stdint.h>
+#include "geometry.h"
+
+// the size of the simulated vertex cache the triangle order is tuned for
+const int VERTEX_CACHE_SIZE = 32;
+
+// gives every distinct (position, uv, normal) index tuple among the corners
+// one vertex; indices[i] becomes the vertex of corner i and first[v] the
+// first corner that uses vertex v, returns the number of vertices
+int weld_corners(const Vec3i *corners, int ncorners, uint32_t *indices, std::vector<int> &first);
+
+// reorders triangles so consecutive ones share vertices, following Tom
+// Forsyth's linear-speed vertex cache optimisation
+void optimize_vertex_cache(uint32_t *indices, int nfaces, int nverts);
+
+// renumbers vertices in the order the triangles first use them; order[v]
+// becomes the old number of new vertex v
+void optimize_vertex_fetch(uint32_t *indices, int nindices, int nverts, std::vector<int> &order);
+
+// a simplified version of a mesh; it keeps only the vertices its triangles
+// use, so drawing it transforms no more than that, and error bounds how far
+// its surface strays from the full one
+struct LodLevel
+{
+    std::vector<uint32_t> vertices;  // the vertex of the full mesh behind each of its own
+    std::vector<Vec3f> positions;    // their positions
+    std::vector<uint32_t> indices;   // into vertices
+    std::vector<Vec3f> normals;      // unit normal per triangle
+    float error;                     // in model units
+};
+
+// simplifies a mesh by quadric error edge collapse (Garland and Heckbert),
+// appending a level with about half the triangles of the one before until
+// fewer than minfaces would be left or nothing more can be collapsed;
+// vertices sharing a position are collapsed together so seams stay closed,
+// and an edge with an end on a uv or normal seam only collapses if it runs
+// along the seam, so that every moved corner keeps its own uv and normal
+void build_lod_chain(const Vec3f *positions, int nverts, const uint32_t *indices, int nfaces, int minfaces, 
+    std::vector<LodLevel> &levels);
+
+#endif //__MESHOPT_H__
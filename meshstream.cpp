@@ -0,0 +1,356 @@
+/**
+ * Reads the triangles of a mesh a chunk at a time, from its binary cache
+ * or straight from the obj text, within a fixed memory budget.
+ */
+
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "meshstream.h"
+
+// the smallest text buffer an obj file is read with
+const size_t STREAM_MIN_TEXT = 1 << 16;
+
+// vertices of a chunk that are at most this far apart in the cache are
+// fetched with one read
+const uint32_t STREAM_RUN_GAP = 16;
+
+// reads size bytes at offset, returns false if the file ends before
+static bool read_at(int fd, void *data, size_t size, uint64_t offset)
+{
+    for (size_t done = 0; done < size; )
+    {
+        ssize_t n = pread(fd, (char *)data + done, size - done, offset + done);
+        if (n <= 0)
+        {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+// writes size bytes, returns false if they did not all make it
+static bool write_all(int fd, const void *data, size_t size)
+{
+    for (size_t done = 0; done < size; )
+    {
+        ssize_t n = write(fd, (const char *)data + done, size - done);
+        if (n <= 0)
+        {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+// opens a temporary file that is gone as soon as it is closed
+static int open_temporary()
+{
+    const char *dir = getenv("TMPDIR");
+    std::string path = std::string(dir && *dir ? dir : "/tmp") + "/meshstream.XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd >= 0)
+    {
+        unlink(path.c_str());
+    }
+    return fd;
+}
+
+MeshStream::MeshStream(const char *filename, size_t memory) : fd_(-1), cached_(false), chunk_faces_(1), bad_(0),
+    next_face_(0), scratch_(), verts_fd_(-1), nverts_(0), text_(), begin_(0), end_(0), eof_(false), corners_(),
+    globals_(), unique_()
+{
+    memset(&header_, 0, sizeof(header_));
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "can't open file " << filename << "\n";
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        return;
+    }
+
+    // an up to date cache is read in place of the obj file
+    size_t size;
+    int cache = open_mesh_cache(filename, st, header_, size);
+    if (cache >= 0)
+    {
+        close(fd);
+        fd_ = cache;
+        cached_ = true;
+        chunk_faces_ = std::max<size_t>(1, memory / STREAM_FACE_BYTES);
+        std::cerr << "# v# " << header_.nverts << " f#" << header_.nfaces << std::endl;
+        return;
+    }
+
+    // a quarter of the budget goes to the text buffer
+    fd_ = fd;
+    text_.resize(std::max(STREAM_MIN_TEXT, memory / 4));
+    chunk_faces_ = std::max<size_t>(1, (memory - std::min(memory, text_.size())) / STREAM_FACE_BYTES);
+    if (!spill_positions())
+    {
+        close(fd_);
+        fd_ = -1;
+        return;
+    }
+    std::cerr << "# v# " << nverts_ << std::endl;
+    rewind();
+}
+
+// copies the positions of the obj file to a temporary file in a first pass
+// over it, through a buffer as large as the text buffer
+bool MeshStream::spill_positions()
+{
+    verts_fd_ = open_temporary();
+    if (verts_fd_ < 0)
+    {
+        std::cerr << "can't create temporary file for vertices\n";
+        return false;
+    }
+
+    rewind();
+    scratch_.clear();
+    bool ok = true;
+    const char *p, *eol;
+    while (ok && read_line(p, eol))
+    {
+        p = obj_skip_spaces(p, eol);
+        if (obj_record_type(p, eol) != OBJ_VERT)
+        {
+            continue;
+        }
+        Vec3f v;
+        bad_ += !obj_parse_vert(p, eol, v);
+        scratch_.insert(scratch_.end(), (const unsigned char *)&v, (const unsigned char *)&v + sizeof(v));
+        nverts_++;
+        if (scratch_.size() >= text_.size())
+        {
+            ok = write_all(verts_fd_, scratch_.data(), scratch_.size());
+            scratch_.clear();
+        }
+    }
+    if (!ok || !write_all(verts_fd_, scratch_.data(), scratch_.size()))
+    {
+        std::cerr << "can't write temporary file for vertices\n";
+        return false;
+    }
+    scratch_.clear();
+    return true;
+}
+
+MeshStream::~MeshStream()
+{
+    if (fd_ >= 0)
+    {
+        close(fd_);
+    }
+    if (verts_fd_ >= 0)
+    {
+        close(verts_fd_);
+    }
+}
+
+bool MeshStream::good()
+{
+    return fd_ >= 0;
+}
+
+bool MeshStream::next(MeshChunk &chunk)
+{
+    chunk.verts.clear();
+    chunk.indices.clear();
+    globals_.clear();
+    if (fd_ < 0 || !(cached_ ? next_cached() : next_obj()))
+    {
+        if (bad_)
+        {
+            std::cerr << "skipped " << bad_ << " malformed records\n";
+            bad_ = 0;
+        }
+        return false;
+    }
+    if (!localize(chunk))
+    {
+        chunk.verts.clear();
+        chunk.indices.clear();
+        return false;
+    }
+    return true;
+}
+
+// goes back to the start of the obj file
+void MeshStream::rewind()
+{
+    lseek(fd_, 0, SEEK_SET);
+    begin_ = end_ = 0;
+    eof_ = false;
+    for (int i = 0; i < OBJ_OTHER; i++)
+    {
+        counts_[i] = 0;
+    }
+}
+
+// finds the next line of the obj file in the text buffer, refilling it as
+// needed; the buffer only grows if a single line does not fit into it
+bool MeshStream::read_line(const char *&p, const char *&eol)
+{
+    for (;;)
+    {
+        const char *begin = text_.data() + begin_;
+        const char *end = text_.data() + end_;
+        if (memchr(begin, '\n', end - begin) || (eof_ && begin < end))
+        {
+            p = begin;
+            const char *next = obj_next_line(begin, end, eol);
+            begin_ = std::min((size_t)(next - text_.data()), end_);
+            return true;
+        }
+        if (eof_)
+        {
+            return false;
+        }
+
+        // moves the partial line to the front and reads more behind it
+        memmove(text_.data(), begin, end - begin);
+        end_ -= begin_;
+        begin_ = 0;
+        if (end_ == text_.size())
+        {
+            text_.resize(2 * text_.size());
+        }
+        ssize_t n = read(fd_, text_.data() + end_, text_.size() - end_);
+        if (n <= 0)
+        {
+            eof_ = true;
+        }
+        else
+        {
+            end_ += n;
+        }
+    }
+}
+
+// collects the position indices of the next chunk_faces_ triangles of the
+// obj file, counting the other records on the way for relative indices
+bool MeshStream::next_obj()
+{
+    const char *p, *eol;
+    while (globals_.size() < 3 * chunk_faces_ && read_line(p, eol))
+    {
+        p = obj_skip_spaces(p, eol);
+        ObjRecord type = obj_record_type(p, eol);
+        if (type == OBJ_FACE)
+        {
+            corners_.resize(3 * obj_face_triangles(p, eol));
+            if (!obj_parse_face(p, eol, counts_, corners_.data()))
+            {
+                bad_++;
+                continue;
+            }
+            for (size_t i = 0; i < corners_.size(); i++)
+            {
+                globals_.push_back(corners_[i].x);
+            }
+        }
+        else if (type != OBJ_OTHER)
+        {
+            counts_[type]++;
+        }
+    }
+    return !globals_.empty();
+}
+
+// reads the indices of the next chunk_faces_ triangles from the cache
+bool MeshStream::next_cached()
+{
+    uint64_t n = std::min<uint64_t>(chunk_faces_, header_.nfaces - next_face_);
+    if (!n)
+    {
+        return false;
+    }
+    size_t bytes = 3 * n * header_.index_bytes;
+    scratch_.resize(bytes);
+    uint64_t offset = header_.offsets[CACHE_INDICES] + 3 * next_face_ * header_.index_bytes;
+    if (!read_at(fd_, scratch_.data(), bytes, offset))
+    {
+        std::cerr << "can't read mesh cache\n";
+        return false;
+    }
+    next_face_ += n;
+
+    globals_.resize(3 * n);
+    for (size_t i = 0; i < globals_.size(); i++)
+    {
+        uint32_t v;
+        if (header_.index_bytes == 2)
+        {
+            uint16_t v16;
+            memcpy(&v16, &scratch_[2 * i], 2);
+            v = v16;
+        }
+        else
+        {
+            memcpy(&v, &scratch_[4 * i], 4);
+        }
+        if (v >= header_.nverts)
+        {
+            std::cerr << "bad index in mesh cache\n";
+            return false;
+        }
+        globals_[i] = v;
+    }
+    return true;
+}
+
+// renumbers the corners of the chunk to its own vertices and fetches
+// those, returns false if they could not be read
+bool MeshStream::localize(MeshChunk &chunk)
+{
+    unique_ = globals_;
+    std::sort(unique_.begin(), unique_.end());
+    unique_.erase(std::unique(unique_.begin(), unique_.end()), unique_.end());
+    chunk.indices.resize(globals_.size());
+    for (size_t i = 0; i < globals_.size(); i++)
+    {
+        chunk.indices[i] = std::lower_bound(unique_.begin(), unique_.end(), globals_[i]) - unique_.begin();
+    }
+
+    // the loader numbered the vertices of a cache in the order triangles
+    // use them, and obj files mostly list them close to their faces, so the
+    // ones of a chunk come in a few runs
+    chunk.verts.resize(unique_.size());
+    int fd = cached_ ? fd_ : verts_fd_;
+    uint64_t base = cached_ ? header_.offsets[CACHE_VERTS] : 0;
+    for (size_t i = 0; i < unique_.size(); )
+    {
+        size_t j = i;
+        while (j + 1 < unique_.size() && unique_[j + 1] - unique_[j] <= STREAM_RUN_GAP)
+        {
+            j++;
+        }
+        size_t count = unique_[j] - unique_[i] + 1;
+        scratch_.resize(count * sizeof(Vec3f));
+        if (!read_at(fd, scratch_.data(), scratch_.size(), base + (uint64_t)unique_[i] * sizeof(Vec3f)))
+        {
+            std::cerr << (cached_ ? "can't read mesh cache\n" : "can't read temporary file for vertices\n");
+            return false;
+        }
+        for (size_t k = i; k <= j; k++)
+        {
+            memcpy(&chunk.verts[k], &scratch_[(unique_[k] - unique_[i]) * sizeof(Vec3f)], sizeof(Vec3f));
+        }
+        i = j + 1;
+    }
+    return true;
+}
@@ -0,0 +1,74 @@
+/**
+ * Header file for reading meshes a bounded chunk at a time, for models
+ * that are too large to load.
+ */
+
+#ifndef __MESHSTREAM_H__
+#define __MESHSTREAM_H__
+
+#include <vector>
+#include <stdint.h>
+#include "geometry.h"
+#include "meshcache.h"
+#include "objparse.h"
+
+// about how much memory a streamed triangle takes on its way through the
+// renderer, chunks are sized with it
+const size_t STREAM_FACE_BYTES = 512;
+
+// the part of a mesh a stream hands out at once, triangles index the
+// vertices of the chunk
+struct MeshChunk
+{
+    std::vector<Vec3f> verts;
+    std::vector<uint32_t> indices;
+};
+
+// reads the triangles of a mesh in chunks that together with the text
+// buffer stay within a memory budget, whatever the size of the mesh; from
+// an obj file the vertex positions are first copied to an unlinked
+// temporary file, since faces may refer back to any of them, and read back
+// chunk by chunk the same way they are from an up to date cache
+class MeshStream
+{
+private:
+    int fd_;
+    bool cached_;
+    size_t chunk_faces_;
+    int bad_;
+
+    // reading from a cache
+    MeshCacheHeader header_;
+    uint64_t next_face_;
+    std::vector<unsigned char> scratch_;
+
+    // reading from an obj file
+    int verts_fd_;  // the temporary file of positions
+    uint64_t nverts_;
+    std::vector<char> text_;
+    size_t begin_;  // the unread part of the text buffer
+    size_t end_;
+    bool eof_;
+    int counts_[OBJ_OTHER];
+    std::vector<Vec3i> corners_;
+
+    // the vertex numbers of the chunk's corners in the whole mesh, and the
+    // distinct ones among them in ascending order
+    std::vector<uint32_t> globals_;
+    std::vector<uint32_t> unique_;
+    bool read_line(const char *&p, const char *&eol);
+    void rewind();
+    bool spill_positions();
+    bool next_cached();
+    bool next_obj();
+    bool localize(MeshChunk &chunk);
+    MeshStream(const MeshStream &);
+    MeshStream &operator=(const MeshStream &);
+public:
+    MeshStream(const char *filename, size_t memory);
+    ~MeshStream();
+    bool good();
+    bool next(MeshChunk &chunk);
+};
+
+#endif //__MESHSTREAM_H__
@@ -3,86 +3,698 @@
  */
 
 #include <iostream>
-#include <string>
-#include <fstream>
-#include <sstream>
 #include <vector>
+#include <algorithm>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "model.h"
+#include "threadpool.h"
+#include "meshcache.h"
+#include "meshopt.h"
+#include "objparse.h"
 
-// parses a obj file for the vertices and faces
-Model::Model(const char *filename) : verts_(), faces_()
+// faces only join a meshlet if their normal is within about 45 degrees of
+// the normal it started from, which keeps the normal cones tight
+const float MESHLET_SPREAD = 0.7f;
+
+// files are split into chunks of at least this many bytes for parsing
+const size_t OBJ_CHUNK_BYTES = 1 << 20;
+
+// loads a obj file from its cache, or parses it for the vertices and faces
+// and writes the cache for next time; flags can ask for meshlets and
+// levels of detail to be built afterwards
+Model::Model(const char *filename, int flags) : verts_(), uvs_(), normals_(), indices16_(), indices32_(), 
+    face_normals_(), nfaces_(0), vert_data_(), uv_data_(), normal_data_(), index16_data_(), index32_data_(), 
+    face_normal_data_(), cache_(NULL), cache_size_(0), meshlets_(), meshlet_faces_(), lods_()
+{
+    bounds_[0] = bounds_[1] = Vec3f();
+
+    // maps the whole file and parses it in place
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "can't open file " << filename << "\n";
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0)
+    {
+        close(fd);
+        return;
+    }
+
+    if (load_cache(filename, st))
+    {
+        close(fd);
+    }
+    else
+    {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+        {
+            std::cerr << "can't map file " << filename << "\n";
+            return;
+        }
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+        parse((const char *)data, (const char *)data + st.st_size);
+        munmap(data, st.st_size);
+
+        // a file with nothing to draw in it is not worth skipping to
+        if (nfaces_ > 0)
+        {
+            save_cache(filename, st);
+        }
+    }
+
+    std::cerr << "# v# " << verts_.size << " f#" << nfaces_ << std::endl;
+
+    if (flags & MODEL_MESHLETS)
+    {
+        build_meshlets(MESHLET_FACES, MESHLET_VERTS);
+        std::cerr << "# meshlets " << meshlets_.size() << std::endl;
+    }
+    if (flags & MODEL_LODS)
+    {
+        build_lods(LOD_MIN_FACES);
+    }
+}
+
+// points the buffers at the arrays of an up to date cache, returns false
+// if there is none
+bool Model::load_cache(const char *filename, const struct stat &source)
+{
+    const MeshCacheHeader *header = map_mesh_cache(filename, source, cache_size_);
+    if (!header)
+    {
+        return false;
+    }
+    // the header only vouches for the layout, indices past the vertices
+    // would be read out of bounds later, so such a cache is dropped and
+    // rebuilt
+    const char *base = (const char *)header;
+    const void *indices = base + header->offsets[CACHE_INDICES];
+    bool valid = true;
+    for (uint64_t i = 0; valid && i < 3ull * header->nfaces; i++)
+    {
+        valid = (header->index_bytes == 2 ? ((const uint16_t *)indices)[i] : ((const uint32_t *)indices)[i]) < 
+            header->nverts;
+    }
+    if (!valid)
+    {
+        std::cerr << "bad mesh cache for " << filename << ", rebuilding it\n";
+        munmap((void *)header, cache_size_);
+        cache_size_ = 0;
+        return false;
+    }
+    cache_ = (void *)header;
+
+    verts_ = ConstSpan<Vec3f>((const Vec3f *)(base + header->offsets[CACHE_VERTS]), header->nverts);
+    uvs_ = ConstSpan<Vec2f>((const Vec2f *)(base + header->offsets[CACHE_UVS]), header->nuvs);
+    normals_ = ConstSpan<Vec3f>((const Vec3f *)(base + header->offsets[CACHE_NORMALS]), header->nnormals);
+    if (header->index_bytes == 2)
+    {
+        indices16_ = ConstSpan<uint16_t>((const uint16_t *)(base + header->offsets[CACHE_INDICES]), 
+            3 * header->nfaces);
+    }
+    else
+    {
+        indices32_ = ConstSpan<uint32_t>((const uint32_t *)(base + header->offsets[CACHE_INDICES]), 
+            3 * header->nfaces);
+    }
+    face_normals_ = ConstSpan<Vec3f>((const Vec3f *)(base + header->offsets[CACHE_FACE_NORMALS]), 
+        header->nfaces);
+    nfaces_ = header->nfaces;
+    bounds_[0] = Vec3f(header->bounds[0], header->bounds[1], header->bounds[2]);
+    bounds_[1] = Vec3f(header->bounds[3], header->bounds[4], header->bounds[5]);
+    return true;
+}
+
+// writes what was parsed from the obj file to its cache
+void Model::save_cache(const char *filename, const struct stat &source)
+{
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.index_bytes = indices16_.size ? 2 : 4;
+    header.nverts = verts_.size;
+    header.nuvs = uvs_.size;
+    header.nnormals = normals_.size;
+    header.nfaces = nfaces_;
+    for (int i = 0; i < 3; i++)
+    {
+        header.bounds[i] = bounds_[0][i];
+        header.bounds[3 + i] = bounds_[1][i];
+    }
+    mesh_cache_layout(header, source);
+
+    const void *arrays[CACHE_NARRAYS] = {verts_.data, uvs_.data, normals_.data, 
+        indices16_.size ? (const void *)indices16_.data : (const void *)indices32_.data, face_normals_.data};
+    write_mesh_cache(filename, header, arrays);
+}
+
+// counts the records of every kind in [begin, end), faces count as the
+// number of triangles they are split into
+static void count_records(const char *begin, const char *end, int *counts)
+{
+    for (int i = 0; i < OBJ_OTHER; i++)
+    {
+        counts[i] = 0;
+    }
+    for (const char *p = begin, *eol; p < end; )
+    {
+        const char *next = obj_next_line(p, end, eol);
+        p = obj_skip_spaces(p, eol);
+        ObjRecord type = obj_record_type(p, eol);
+        if (type == OBJ_FACE)
+        {
+            counts[type] += obj_face_triangles(p, eol);
+        }
+        else if (type != OBJ_OTHER)
+        {
+            counts[type]++;
+        }
+        p = next;
+    }
+}
+
+// parses a part of the file; its i-th vertex is written to vert_data_[at[OBJ_VERT] + i]
+// and so on, which also gives relative indices what they refer to; the
+// (position, uv, normal) index tuples of the triangle corners go to
+// corners, -1 for what a corner does not have and for every corner of a
+// malformed face; returns the number of malformed records
+int Model::parse_records(const char *begin, const char *end, const int *at, Vec3i *corners)
+{
+    int count[OBJ_OTHER];
+    for (int i = 0; i < OBJ_OTHER; i++)
+    {
+        count[i] = at[i];
+    }
+
+    int bad = 0;
+    for (const char *p = begin, *eol; p < end; )
+    {
+        const char *next = obj_next_line(p, end, eol);
+        p = obj_skip_spaces(p, eol);
+        ObjRecord type = obj_record_type(p, eol);
+        if (type == OBJ_VERT)
+        {
+            bad += !obj_parse_vert(p, eol, vert_data_[count[OBJ_VERT]++]);
+        }
+        else if (type == OBJ_UV)
+        {
+            bad += !obj_parse_uv(p, eol, uv_data_[count[OBJ_UV]++]);
+        }
+        else if (type == OBJ_NORMAL)
+        {
+            bad += !obj_parse_normal(p, eol, normal_data_[count[OBJ_NORMAL]++]);
+        }
+        else if (type == OBJ_FACE)
+        {
+            Vec3i *tri = &corners[3 * (size_t)count[OBJ_FACE]];
+            bad += !obj_parse_face(p, eol, count, tri);
+            count[OBJ_FACE] += obj_face_triangles(p, eol);
+        }
+        p = next;
+    }
+    return bad;
+}
+
+// splits the file into chunks that start at line boundaries and parses
+// them in parallel; a first pass counts the records of every chunk, so each
+// one knows where its elements go and what its relative indices refer to
+void Model::parse(const char *begin, const char *end)
+{
+    ThreadPool pool;
+    size_t size = end - begin;
+    int nchunks = std::max(1, (int)std::min<size_t>(size / OBJ_CHUNK_BYTES, pool.size() * 4));
+    std::vector<const char *> bounds(nchunks + 1, end);
+    bounds[0] = begin;
+    for (int i = 1; i < nchunks; i++)
+    {
+        const char *p = std::max(begin + size * i / nchunks, bounds[i - 1]);
+        const char *nl = (const char *)memchr(p, '\n', end - p);
+        bounds[i] = nl ? nl + 1 : end;
+    }
+
+    // counts[i] first holds the records of chunk i, then the ones before it
+    std::vector<int> counts((nchunks + 1) * OBJ_OTHER, 0);
+    pool.parallel_for(nchunks, [&](int i)
+    {
+        count_records(bounds[i], bounds[i + 1], &counts[(i + 1) * OBJ_OTHER]);
+    });
+    for (int i = 1; i <= nchunks; i++)
+    {
+        for (int j = 0; j < OBJ_OTHER; j++)
+        {
+            counts[i * OBJ_OTHER + j] += counts[(i - 1) * OBJ_OTHER + j];
+        }
+    }
+    const int *total = &counts[nchunks * OBJ_OTHER];
+    vert_data_.resize(total[OBJ_VERT]);
+    uv_data_.resize(total[OBJ_UV]);
+    normal_data_.resize(total[OBJ_NORMAL]);
+    std::vector<Vec3i> corners(3 * (size_t)total[OBJ_FACE]);
+
+    std::vector<int> bad(nchunks);
+    pool.parallel_for(nchunks, [&](int i)
+    {
+        bad[i] = parse_records(bounds[i], bounds[i + 1], &counts[i * OBJ_OTHER], corners.data());
+    });
+
+    // drops the triangles of malformed faces
+    corners.erase(std::remove_if(corners.begin(), corners.end(), [](const Vec3i &c) { return c.x < 0; }), 
+        corners.end());
+    nfaces_ = (int)(corners.size() / 3);
+    weld(corners);
+
+    // narrows the indices when 16 bits are enough for every vertex
+    if (vert_data_.size() <= 0x10000)
+    {
+        index16_data_.assign(index32_data_.begin(), index32_data_.end());
+        std::vector<uint32_t>().swap(index32_data_);
+    }
+    verts_ = vert_data_;
+    uvs_ = uv_data_;
+    normals_ = normal_data_;
+    indices16_ = index16_data_;
+    indices32_ = index32_data_;
+
+    // precomputes what the cache keeps besides the parsed data
+    face_normal_data_.resize(nfaces_);
+    pool.parallel_for(nchunks, [&](int i)
+    {
+        for (int f = nfaces_ * (long long)i / nchunks; f < nfaces_ * (long long)(i + 1) / nchunks; f++)
+        {
+            Vec3i v = face(f);
+            Vec3f n = cross(verts_[v[2]] - verts_[v[0]], verts_[v[1]] - verts_[v[0]]);
+            face_normal_data_[f] = n.normalize();
+        }
+    });
+    face_normals_ = face_normal_data_;
+    if (verts_.size)
+    {
+        bounds_[0] = bounds_[1] = verts_[0];
+    }
+    for (int i = 0; i < verts_.size; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            bounds_[0][j] = std::min(bounds_[0][j], verts_[i][j]);
+            bounds_[1][j] = std::max(bounds_[1][j], verts_[i][j]);
+        }
+    }
+    int nbad = 0;
+    for (int i = 0; i < nchunks; i++)
+    {
+        nbad += bad[i];
+    }
+    if (nbad)
+    {
+        std::cerr << "skipped " << nbad << " malformed records\n";
+    }
+}
+
+// turns the corners into an indexed mesh with one vertex per distinct
+// (position, uv, normal) tuple, then orders the triangles for the vertex
+// cache and the vertices for the order they are fetched in
+void Model::weld(const std::vector<Vec3i> &corners)
+{
+    index32_data_.resize(corners.size());
+    std::vector<int> first;
+    int nverts = weld_corners(corners.data(), (int)corners.size(), index32_data_.data(), first);
+    optimize_vertex_cache(index32_data_.data(), nfaces_, nverts);
+    std::vector<int> order;
+    optimize_vertex_fetch(index32_data_.data(), (int)index32_data_.size(), nverts, order);
+
+    // attributes only some corners have are 0 for the others
+    bool hasuvs = false, hasnormals = false;
+    for (size_t i = 0; i < corners.size(); i++)
+    {
+        hasuvs = hasuvs || corners[i].y >= 0;
+        hasnormals = hasnormals || corners[i].z >= 0;
+    }
+    std::vector<Vec3f> positions(nverts);
+    std::vector<Vec2f> uvs(hasuvs ? nverts : 0);
+    std::vector<Vec3f> normals(hasnormals ? nverts : 0);
+    for (int v = 0; v < nverts; v++)
+    {
+        const Vec3i &c = corners[first[order[v]]];
+        positions[v] = vert_data_[c.x];
+        if (hasuvs)
+        {
+            uvs[v] = c.y >= 0 ? uv_data_[c.y] : Vec2f();
+        }
+        if (hasnormals)
+        {
+            normals[v] = c.z >= 0 ? normal_data_[c.z] : Vec3f();
+        }
+    }
+    vert_data_.swap(positions);
+    uv_data_.swap(uvs);
+    normal_data_.swap(normals);
+}
+
+// zero area faces have no direction, their normal is not a number
+static bool degenerate(Vec3f n)
 {
-    std::ifstream in;
+    return !(n * n > 0.5f);
+}
 
-    // opens obj file
-    in.open(filename, std::ifstream::in);
-    if (in.fail()) return;
+// grows meshlets greedily over faces sharing a vertex, starting each one
+// from the first face that is not in a meshlet yet
+void Model::build_meshlets(int maxfaces, int maxverts)
+{
+    int nv = verts_.size;
+    int nf = nfaces_;
 
-    std::string line;
-    while (!in.eof())
+    // the faces around every vertex
+    std::vector<int> start(nv + 1, 0);
+    for (int i = 0; i < nf; i++)
     {
-        std::getline(in, line);
-        std::istringstream iss(line.c_str());
-        char trash; 
-        if (!line.compare(0, 2, "v "))
+        for (int j = 0; j < 3; j++)
         {
-            iss >> trash; // get rid of the "v " part
+            start[face(i)[j] + 1]++;
+        }
+    }
+    for (int i = 0; i < nv; i++)
+    {
+        start[i + 1] += start[i];
+    }
+    std::vector<int> around(start[nv]);
+    std::vector<int> fill(start.begin(), start.end() - 1);
+    for (int i = 0; i < nf; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            around[fill[face(i)[j]]++] = i;
+        }
+    }
+
+    std::vector<Vec3f> normals(nf);
+    for (int i = 0; i < nf; i++)
+    {
+        normals[i] = normal(i);
+    }
 
-            // add the coordinates to a new vector
-            Vec3f v;
-            for (int i = 0; i < 3; i++)
+    std::vector<bool> used(nf, false);
+    std::vector<int> stamp(nv, -1);  // the last meshlet a vertex was counted for
+    std::vector<int> queue;
+    for (int seed = 0; seed < nf; seed++)
+    {
+        if (used[seed])
+        {
+            continue;
+        }
+
+        Meshlet m;
+        m.first = (int)meshlet_faces_.size();
+        m.nfaces = 0;
+        int id = (int)meshlets_.size();
+        int nverts = 0;
+        Vec3f reference;
+        bool oriented = false;
+
+        // faces that are rejected stay available as seeds of later meshlets
+        queue.assign(1, seed);
+        for (size_t q = 0; q < queue.size() && m.nfaces < maxfaces; q++)
+        {
+            int f = queue[q];
+            if (used[f])
+            {
+                continue;
+            }
+            if (oriented && !degenerate(normals[f]) && normals[f] * reference < MESHLET_SPREAD)
+            {
+                continue;
+            }
+            int added = 0;
+            Vec3i corners = face(f);
+            for (int j = 0; j < 3; j++)
             {
-                iss >> v.raw[i];
+                added += stamp[corners[j]] != id;
+            }
+            if (m.nfaces && nverts + added > maxverts)
+            {
+                continue;
             }
 
-            // add new vertice to list of vertices
-            verts_.push_back(v);
-        } 
-        else if (!line.compare(0, 2, "f "))
-        {
-            std::vector<int> f;
-            int itrash, idx;
+            used[f] = true;
+            meshlet_faces_.push_back(f);
+            m.nfaces++;
+            nverts += added;
+            if (!oriented && !degenerate(normals[f]))
+            {
+                reference = normals[f];
+                oriented = true;
+            }
+            for (int j = 0; j < 3; j++)
+            {
+                int v = corners[j];
+                stamp[v] = id;
+                for (int k = start[v]; k < start[v + 1]; k++)
+                {
+                    if (!used[around[k]])
+                    {
+                        queue.push_back(around[k]);
+                    }
+                }
+            }
+        }
 
-            iss >> trash; // gets rid of the "f " part
+        // bounding sphere around the center of the bounding box
+        Vec3f lo = verts_[face(seed)[0]];
+        Vec3f hi = lo;
+        Vec3f sum;
+        for (int i = m.first; i < m.first + m.nfaces; i++)
+        {
+            int f = meshlet_faces_[i];
+            for (int j = 0; j < 3; j++)
+            {
+                Vec3f v = verts_[face(f)[j]];
+                for (int k = 0; k < 3; k++)
+                {
+                    lo[k] = std::min(lo[k], v[k]);
+                    hi[k] = std::max(hi[k], v[k]);
+                }
+            }
+            if (!degenerate(normals[f]))
+            {
+                sum = sum + normals[f];
+            }
+        }
+        m.center = (lo + hi) * 0.5f;
+        m.radius = 0;
+        for (int i = m.first; i < m.first + m.nfaces; i++)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                Vec3f d = verts_[face(meshlet_faces_[i])[j]] - m.center;
+                m.radius = std::max(m.radius, d.norm());
+            }
+        }
 
-            // gets the first number after each space, adds it to a new
-            // vector, and adds the vector to the list of faces
-            while (iss >> idx >> trash >> itrash >> trash >> itrash)
+        // normal cone around the average normal, widened a little so that
+        // rounding can never cull a face that is not back-facing
+        m.axis = Vec3f(0, 0, 1);
+        m.cutoff = -1;
+        if (!degenerate(sum.normalize()))
+        {
+            m.axis = sum;
+            m.cutoff = 1;
+            for (int i = m.first; i < m.first + m.nfaces; i++)
             {
-                idx--;
-                f.push_back(idx);
+                Vec3f n = normals[meshlet_faces_[i]];
+                if (!degenerate(n))
+                {
+                    m.cutoff = std::min(m.cutoff, n * m.axis);
+                }
             }
-            faces_.push_back(f);
+            m.cutoff = std::max(m.cutoff - 1e-3f, -1.f);
         }
+        meshlets_.push_back(m);
     }
-    
-    std::cerr << "# v# " << verts_.size() << " f#" << faces_.size() << std::endl;
 }
 
-// destructor
-Model::~Model() {}
+// simplifies the model into a chain of levels of detail, each with about
+// half the faces of the one before
+void Model::build_lods(int minfaces)
+{
+    std::vector<uint32_t> indices(indices32_.begin(), indices32_.end());
+    if (indices16_.size)
+    {
+        indices.assign(indices16_.begin(), indices16_.end());
+    }
+    build_lod_chain(verts_.data, verts_.size, indices.data(), nfaces_, minfaces, lods_);
+    std::cerr << "# lods";
+    for (size_t i = 0; i < lods_.size(); i++)
+    {
+        std::cerr << " f#" << lods_[i].normals.size();
+    }
+    std::cerr << std::endl;
+}
+
+// destructor, unmaps the cache the model was loaded from
+Model::~Model()
+{
+    if (cache_)
+    {
+        munmap(cache_, cache_size_);
+    }
+}
 
 // returns the number of vertices
-int Model::nverts()
+int Model::nverts() const
 {
-    return (int)verts_.size();
+    return verts_.size;
 }
 
-// returns the number of faces
-int Model::nfaces()
+// returns the number of faces, polygons count as their triangles
+int Model::nfaces() const
 {
-    return (int)faces_.size();
+    return nfaces_;
 }
 
-// returns the 3 vertices that make up a face as a vector at index i
-std::vector<int> Model::face(int i)
+// returns the 3 vertices that make up face i, read from the index buffer
+Vec3i Model::face(int i) const
 {
-    return faces_[i];
+    if (indices16_.size)
+    {
+        const uint16_t *f = &indices16_[3 * (size_t)i];
+        return Vec3i(f[0], f[1], f[2]);
+    }
+    const uint32_t *f = &indices32_[3 * (size_t)i];
+    return Vec3i(f[0], f[1], f[2]);
+}
+
+// returns the unit normal of face i, computed once while loading
+Vec3f Model::normal(int i) const
+{
+    return face_normals_[i];
+}
+
+// returns the number of meshlets, 0 unless they were asked for
+int Model::nmeshlets() const
+{
+    return (int)meshlets_.size();
+}
+
+// returns meshlet i, its faces are meshlet_face(first) to
+// meshlet_face(first + nfaces - 1)
+Meshlet Model::meshlet(int i) const
+{
+    return meshlets_[i];
+}
+
+// returns the face index stored at position i of the meshlet face list
+int Model::meshlet_face(int i) const
+{
+    return meshlet_faces_[i];
+}
+
+// returns the number of levels of detail, level 0 being the model itself
+int Model::nlods() const
+{
+    return 1 + (int)lods_.size();
+}
+
+// returns the positions of the vertices a level of detail uses, which its
+// faces index; level 0 uses every vertex of the model
+ConstSpan<Vec3f> Model::lod_verts(int level) const
+{
+    return level ? ConstSpan<Vec3f>(lods_[level - 1].positions) : verts_;
+}
+
+// returns the vertex of the model behind vertex i of a level of detail,
+// for its uv and normal
+int Model::lod_vertex(int level, int i) const
+{
+    return level ? (int)lods_[level - 1].vertices[i] : i;
+}
+
+// returns the number of faces of a level of detail
+int Model::lod_nfaces(int level) const
+{
+    return level ? (int)lods_[level - 1].normals.size() : nfaces_;
+}
+
+// returns the 3 vertices of face i of a level of detail, see lod_verts()
+Vec3i Model::lod_face(int level, int i) const
+{
+    if (!level)
+    {
+        return face(i);
+    }
+    const uint32_t *f = &lods_[level - 1].indices[3 * (size_t)i];
+    return Vec3i(f[0], f[1], f[2]);
+}
+
+// returns the unit normal of face i of a level of detail
+Vec3f Model::lod_normal(int level, int i) const
+{
+    return level ? lods_[level - 1].normals[i] : face_normals_[i];
+}
+
+// returns how far in model units a level of detail may be from the model
+float Model::lod_error(int level) const
+{
+    return level ? lods_[level - 1].error : 0;
+}
+
+// returns the number of texture coordinates, one per vertex or none
+int Model::nuvs() const
+{
+    return uvs_.size;
+}
+
+// returns the texture coordinate of vertex i
+Vec2f Model::uv(int i) const
+{
+    return uvs_[i];
+}
+
+// returns the number of vertex normals, one per vertex or none
+int Model::nnormals() const
+{
+    return normals_.size;
+}
+
+// returns the bounding box of the vertices
+void Model::bounds(Vec3f &lo, Vec3f &hi) const
+{
+    lo = bounds_[0];
+    hi = bounds_[1];
+}
+
+// returns the normal of vertex i, as given in the file
+Vec3f Model::vert_normal(int i) const
+{
+    return normals_[i];
 }
 
 // returns the vertice at index i
-Vec3f Model::vert(int i)
+Vec3f Model::vert(int i) const
 {
     return verts_[i];
 }
 
+// returns every vertex position as one flat buffer
+ConstSpan<Vec3f> Model::verts() const
+{
+    return verts_;
+}
+
+// returns the index buffer if it is 16 bits wide, otherwise an empty span
+ConstSpan<uint16_t> Model::indices16() const
+{
+    return indices16_;
+}
+
+// returns the index buffer if it is 32 bits wide, otherwise an empty span
+ConstSpan<uint32_t> Model::indices32() const
+{
+    return indices32_;
+}
@@ -6,20 +6,112 @@
 #define __MODEL_H__
 
 #include <vector>
+#include <stdint.h>
+#include <sys/stat.h>
 #include "geometry.h"
+#include "meshopt.h"
+
+// default limits for the faces and distinct vertices of a meshlet
+const int MESHLET_FACES = 64;
+const int MESHLET_VERTS = 64;
+
+// levels of detail stop before they would have fewer faces than this
+const int LOD_MIN_FACES = 64;
+
+// what a model builds after loading besides its buffers
+enum ModelFlags
+{
+    MODEL_MESHLETS = 1,  // clusters of faces for culling
+    MODEL_LODS = 2       // simplified levels of detail
+};
+
+// a small cluster of neighbouring faces that can be culled as a whole
+struct Meshlet
+{
+    int first;      // index of its first face in the meshlet face list
+    int nfaces;
+    Vec3f center;   // bounding sphere
+    float radius;
+    Vec3f axis;     // normal cone: every face normal n has n * axis >= cutoff
+    float cutoff;   // the cosine of the cone's half angle, -1 if it is open
+};
+
+// a read-only view of size consecutive elements, in the spirit of std::span
+template <typename T> struct ConstSpan
+{
+    const T *data;
+    int size;
+
+    ConstSpan() : data(NULL), size(0) {}
+    ConstSpan(const T *d, int n) : data(d), size(n) {}
+    ConstSpan(const std::vector<T> &v) : data(v.data()), size((int)v.size()) {}
+
+    const T &operator[](int i) const { return data[i]; }
+    const T *begin() const { return data; }
+    const T *end() const { return data + size; }
+};
 
 class Model
 {
 private:
-    std::vector<Vec3f> verts_;
-    std::vector<std::vector<int> > faces_;
+    // the model's buffers; they point into the vectors below when the obj
+    // file was parsed, or straight into the mapped cache when it was loaded
+    ConstSpan<Vec3f> verts_;
+    ConstSpan<Vec2f> uvs_;
+    ConstSpan<Vec3f> normals_;
+    ConstSpan<uint16_t> indices16_;  // three per triangle when 16 bits can name every vertex
+    ConstSpan<uint32_t> indices32_;  // otherwise these, only one of them is filled
+    ConstSpan<Vec3f> face_normals_;
+    int nfaces_;
+    Vec3f bounds_[2];
+
+    std::vector<Vec3f> vert_data_;
+    std::vector<Vec2f> uv_data_;
+    std::vector<Vec3f> normal_data_;
+    std::vector<uint16_t> index16_data_;
+    std::vector<uint32_t> index32_data_;
+    std::vector<Vec3f> face_normal_data_;
+    void *cache_;
+    size_t cache_size_;
+
+    std::vector<Meshlet> meshlets_;
+    std::vector<int> meshlet_faces_;
+    std::vector<LodLevel> lods_;
+    void parse(const char *begin, const char *end);
+    int parse_records(const char *begin, const char *end, const int *at, Vec3i *corners);
+    void weld(const std::vector<Vec3i> &corners);
+    bool load_cache(const char *filename, const struct stat &source);
+    void save_cache(const char *filename, const struct stat &source);
+    void build_meshlets(int maxfaces, int maxverts);
+    void build_lods(int minfaces);
+    Model(const Model &);
+    Model &operator=(const Model &);
 public:
-    Model(const char *filename);
+    Model(const char *filename, int flags = 0);
     ~Model();
-    int nverts();
-    int nfaces();
-    Vec3f vert(int i);
-    std::vector<int> face(int idx);
+    int nverts() const;
+    int nfaces() const;
+    Vec3f vert(int i) const;
+    Vec3i face(int idx) const;
+    Vec3f normal(int idx) const;
+    int nuvs() const;
+    Vec2f uv(int i) const;
+    int nnormals() const;
+    Vec3f vert_normal(int i) const;
+    void bounds(Vec3f &lo, Vec3f &hi) const;
+    ConstSpan<Vec3f> verts() const;
+    ConstSpan<uint16_t> indices16() const;
+    ConstSpan<uint32_t> indices32() const;
+    int nmeshlets() const;
+    Meshlet meshlet(int i) const;
+    int meshlet_face(int i) const;
+    int nlods() const;
+    ConstSpan<Vec3f> lod_verts(int level) const;
+    int lod_vertex(int level, int i) const;
+    int lod_nfaces(int level) const;
+    Vec3i lod_face(int level, int i) const;
+    Vec3f lod_normal(int level, int i) const;
+    float lod_error(int level) const;
 };
 
 #endif //__MODEL_H__
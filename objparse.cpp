@@ -0,0 +1,180 @@
+/**
+ * Parsing of single obj records in place, without allocating.
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <string.h>
+#include "objparse.h"
+
+const char *obj_skip_spaces(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+    {
+        p++;
+    }
+    return p;
+}
+
+// parses a number at p in place, returns the position after it or NULL
+static const char *parse_float(const char *p, const char *end, float &value)
+{
+    p = obj_skip_spaces(p, end);
+    if (p < end && *p == '+')
+    {
+        p++;
+    }
+    std::from_chars_result res = std::from_chars(p, end, value);
+    return res.ec == std::errc() ? res.ptr : NULL;
+}
+
+static const char *parse_int(const char *p, const char *end, int &value)
+{
+    if (p < end && *p == '+')
+    {
+        p++;
+    }
+    std::from_chars_result res = std::from_chars(p, end, value);
+    return res.ec == std::errc() ? res.ptr : NULL;
+}
+
+// turns a 1-based or negative (counted back from the last one) obj index
+// into a 0-based one, returns false if it does not name an existing element
+static bool resolve_index(int idx, int count, int &out)
+{
+    out = idx < 0 ? count + idx : idx - 1;
+    return idx != 0 && out >= 0 && out < count;
+}
+
+const char *obj_next_line(const char *p, const char *end, const char *&eol)
+{
+    eol = (const char *)memchr(p, '\n', end - p);
+    if (!eol)
+    {
+        eol = end;
+    }
+    const char *next = eol + 1;
+    if (eol > p && eol[-1] == '\r')
+    {
+        eol--;
+    }
+    return next;
+}
+
+ObjRecord obj_record_type(const char *p, const char *eol)
+{
+    if (eol - p < 2)
+    {
+        return OBJ_OTHER;
+    }
+    bool space = p[1] == ' ' || p[1] == '\t';
+    if (p[0] == 'v')
+    {
+        return space ? OBJ_VERT : p[1] == 't' ? OBJ_UV : p[1] == 'n' ? OBJ_NORMAL : OBJ_OTHER;
+    }
+    return p[0] == 'f' && space ? OBJ_FACE : OBJ_OTHER;
+}
+
+int obj_face_triangles(const char *p, const char *eol)
+{
+    int corners = 0;
+    for (p = obj_skip_spaces(p + 1, eol); p < eol; p = obj_skip_spaces(p, eol))
+    {
+        corners++;
+        while (p < eol && *p != ' ' && *p != '\t')
+        {
+            p++;
+        }
+    }
+    return std::max(corners - 2, 0);
+}
+
+bool obj_parse_vert(const char *p, const char *eol, Vec3f &v)
+{
+    const char *q = p + 1;
+    for (int i = 0; q && i < 3; i++)
+    {
+        q = parse_float(q, eol, v[i]);
+    }
+    return q;
+}
+
+bool obj_parse_uv(const char *p, const char *eol, Vec2f &uv)
+{
+    // a missing v coordinate stays 0, a w coordinate is ignored
+    const char *q = parse_float(p + 2, eol, uv.x);
+    if (q && obj_skip_spaces(q, eol) < eol)
+    {
+        q = parse_float(q, eol, uv.y);
+    }
+    return q;
+}
+
+bool obj_parse_normal(const char *p, const char *eol, Vec3f &n)
+{
+    const char *q = p + 2;
+    for (int i = 0; q && i < 3; i++)
+    {
+        q = parse_float(q, eol, n[i]);
+    }
+    return q;
+}
+
+bool obj_parse_face(const char *p, const char *eol, const int *count, Vec3i *corners)
+{
+    // nothing to write to for faces with less than three corners
+    if (!obj_face_triangles(p, eol))
+    {
+        return false;
+    }
+
+    // every corner is v, v/vt, v//vn or v/vt/vn
+    int ncorners = 0;
+    bool ok = true;
+    const char *q = obj_skip_spaces(p + 1, eol);
+    while (ok && q < eol)
+    {
+        int idx;
+        Vec3i v(-1, -1, -1);
+        q = parse_int(q, eol, idx);
+        ok = q && resolve_index(idx, count[OBJ_VERT], v.x);
+        if (ok && q < eol && *q == '/')
+        {
+            q++;
+            if (q < eol && *q != '/')
+            {
+                q = parse_int(q, eol, idx);
+                ok = q && resolve_index(idx, count[OBJ_UV], v.y);
+            }
+            if (ok && q < eol && *q == '/')
+            {
+                q = parse_int(q + 1, eol, idx);
+                ok = q && resolve_index(idx, count[OBJ_NORMAL], v.z);
+            }
+        }
+        ok = ok && (q == eol || *q == ' ' || *q == '\t');
+        if (ok)
+        {
+            // corner k >= 2 closes triangle (0, k - 1, k)
+            if (ncorners >= 2)
+            {
+                Vec3i *out = corners + 3 * (ncorners - 2);
+                out[0] = corners[0];
+                out[1] = ncorners == 2 ? corners[1] : out[-1];
+                out[2] = v;
+            }
+            else
+            {
+                corners[ncorners] = v;
+            }
+            ncorners++;
+            q = obj_skip_spaces(q, eol);
+        }
+    }
+    if (!ok || ncorners < 3)
+    {
+        std::fill(corners, corners + 3 * obj_face_triangles(p, eol), Vec3i(-1, -1, -1));
+        return false;
+    }
+    return true;
+}
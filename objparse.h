@@ -0,0 +1,46 @@
+/**
+ * Header file for the line level parsing of obj files, shared by the
+ * model loader and the streaming renderer.
+ */
+
+#ifndef __OBJPARSE_H__
+#define __OBJPARSE_H__
+
+#include "geometry.h"
+
+// the kinds of obj records the parser keeps
+enum ObjRecord
+{
+    OBJ_VERT,
+    OBJ_UV,
+    OBJ_NORMAL,
+    OBJ_FACE,
+    OBJ_OTHER
+};
+
+// finds the line starting at p, sets eol to its end without the line break
+// and returns the start of the next one
+const char *obj_next_line(const char *p, const char *end, const char *&eol);
+
+// obj tokens are separated by spaces or tabs
+const char *obj_skip_spaces(const char *p, const char *end);
+
+// the kind of record a line holds, p is its first non-space character
+ObjRecord obj_record_type(const char *p, const char *eol);
+
+// polygons are split into a fan of triangles, one less than they have
+// corners after the first
+int obj_face_triangles(const char *p, const char *eol);
+
+// parse the record starting at p, return false if it is malformed
+bool obj_parse_vert(const char *p, const char *eol, Vec3f &v);
+bool obj_parse_uv(const char *p, const char *eol, Vec2f &uv);
+bool obj_parse_normal(const char *p, const char *eol, Vec3f &n);
+
+// parses a face with count[OBJ_VERT] vertices and so on before it, so its
+// relative indices can be resolved; writes the (position, uv, normal) index
+// tuples of its obj_face_triangles() triangles to corners, -1 for what a
+// corner does not have and for every corner if the face is malformed
+bool obj_parse_face(const char *p, const char *eol, const int *count, Vec3i *corners);
+
+#endif //__OBJPARSE_H__
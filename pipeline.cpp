@@ -0,0 +1,417 @@
+/**
+ * The vertex stage: camera matrices and the per-frame transform of all
+ * model vertices to screen space.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "pipeline.h"
+
+Matrix viewport(int x, int y, int w, int h)
+{
+    Matrix m = Matrix::identity();
+    m[0][3] = x + w / 2.f;
+    m[1][3] = y + h / 2.f;
+    m[0][0] = w / 2.f;
+    m[1][1] = h / 2.f;
+    return m;
+}
+
+Matrix projection(float c)
+{
+    Matrix m = Matrix::identity();
+    if (c != 0)
+    {
+        m[3][2] = -1.f / c;
+    }
+    return m;
+}
+
+Matrix rotation_y(float angle)
+{
+    Matrix m = Matrix::identity();
+    m[0][0] = m[2][2] = std::cos(angle);
+    m[0][2] = std::sin(angle);
+    m[2][0] = -std::sin(angle);
+    return m;
+}
+
+Matrix lookat(Vec3f eye, Vec3f center, Vec3f up)
+{
+    Vec3f z = (eye - center).normalize();
+    Vec3f x = cross(up, z).normalize();
+    Vec3f y = cross(z, x).normalize();
+    Matrix minv = Matrix::identity();
+    Matrix tr = Matrix::identity();
+    for (int i = 0; i < 3; i++)
+    {
+        minv[0][i] = x[i];
+        minv[1][i] = y[i];
+        minv[2][i] = z[i];
+        tr[i][3] = -center[i];
+    }
+    return minv * tr;
+}
+
+// near, left, right, bottom and top
+const int NPLANES = 5;
+
+// signed distances of a homogeneous point to the clip planes, negative is outside
+static void plane_distances(const Vec4f &v, int width, int height, float *d)
+{
+    d[0] = v[3] - NEAR_W;
+    d[1] = v[0] + GUARD_BAND * v[3];
+    d[2] = (width + GUARD_BAND) * v[3] - v[0];
+    d[3] = v[1] + GUARD_BAND * v[3];
+    d[4] = (height + GUARD_BAND) * v[3] - v[1];
+}
+
+static unsigned int outcode(const Vec4f &v, int width, int height)
+{
+    float d[NPLANES];
+    plane_distances(v, width, height, d);
+    unsigned int code = 0;
+    for (int i = 0; i < NPLANES; i++)
+    {
+        code |= (d[i] < 0) << i;
+    }
+    return code;
+}
+
+static Vec3f divide(const Vec4f &v)
+{
+    return Vec3f(v[0] / v[3], v[1] / v[3], v[2] / v[3]);
+}
+
+// the point where segment (in, out) crosses a plane; always computed from
+// the inside end, so triangles sharing the edge get exactly the same point
+static Vec4f intersect(const Vec4f &in, float din, const Vec4f &out, float dout)
+{
+    float t = din / (din - dout);
+    return in + (out - in) * t;
+}
+
+void transform_vertices(const Vec3f *positions, const Matrix &m, int width, int height, ScreenVertex *verts, 
+    int begin, int end)
+{
+    // copy the matrix out once instead of going through the checked accessors
+    float r[4][4];
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            r[i][j] = m[i][j];
+        }
+    }
+
+    for (int i = begin; i < end; i++)
+    {
+        const Vec3f &v = positions[i];
+        ScreenVertex &out = verts[i];
+        for (int j = 0; j < 4; j++)
+        {
+            out.clip[j] = r[j][0] * v.x + r[j][1] * v.y + r[j][2] * v.z + r[j][3];
+        }
+        out.outcode = outcode(out.clip, width, height);
+        out.screen = out.outcode ? Vec3f() : divide(out.clip);
+    }
+}
+
+void transform_vertices(const Model &model, const Matrix &m, int width, int height, ScreenVertex *verts, 
+    int begin, int end)
+{
+    transform_vertices(model.verts().data, m, width, height, verts, begin, end);
+}
+
+void transform_vertices(const Model &model, const Matrix &m, int width, int height, 
+    std::vector<ScreenVertex> &verts)
+{
+    verts.resize(model.nverts());
+    transform_vertices(model, m, width, height, verts.data(), 0, model.nverts());
+}
+
+void transform_vertices(const Model &model, int level, const Matrix &m, int width, int height, 
+    std::vector<ScreenVertex> &verts)
+{
+    ConstSpan<Vec3f> positions = model.lod_verts(level);
+    verts.resize(positions.size);
+    transform_vertices(positions.data, m, width, height, verts.data(), 0, positions.size);
+}
+
+bool meshlet_backfacing(const Meshlet &meshlet, Vec3f dir)
+{
+    // an open cone always has some face towards dir; otherwise every normal
+    // is within the cone's half angle a of the axis, and all of them face
+    // away once the axis is more than 90 + a degrees from dir
+    if (meshlet.cutoff < 0)
+    {
+        return false;
+    }
+    float sine = std::sqrt(1 - meshlet.cutoff * meshlet.cutoff);
+    return meshlet.axis * dir < -sine * dir.norm();
+}
+
+bool sphere_outside(Vec3f center, float radius, const Matrix &m, int width, int height)
+{
+    // the near plane and the image edges as homogeneous planes p * clip + k >= 0
+    const float planes[NPLANES][5] = {
+        {0, 0, 0, 1, -NEAR_W},
+        {1, 0, 0, 0, 0},
+        {-1, 0, 0, (float)width, 0},
+        {0, 1, 0, 0, 0},
+        {0, -1, 0, (float)height, 0}
+    };
+
+    // pulled back through m, each one is a plane in model space
+    for (int i = 0; i < NPLANES; i++)
+    {
+        Vec3f normal;
+        float offset = planes[i][4];
+        for (int j = 0; j < 4; j++)
+        {
+            float q = 0;
+            for (int k = 0; k < 4; k++)
+            {
+                q += planes[i][k] * m[k][j];
+            }
+            if (j < 3)
+            {
+                normal[j] = q;
+            }
+            else
+            {
+                offset += q;
+            }
+        }
+        if (normal * center + offset < -radius * normal.norm())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool meshlet_outside(const Meshlet &meshlet, const Matrix &m, int width, int height)
+{
+    return sphere_outside(meshlet.center, meshlet.radius, m, width, height);
+}
+
+int select_lod(const Model &model, const Matrix &m, float maxerror)
+{
+    Vec3f lo, hi;
+    model.bounds(lo, hi);
+    Vec3f center = (lo + hi) * 0.5f;
+    float radius = (hi - lo).norm() * 0.5f;
+
+    // pixels per model unit: the derivative of the screen position at the
+    // sphere's center, divided by the smallest w on the sphere
+    Vec4f c = m * embed<4>(center);
+    Vec3f wrow(m[3][0], m[3][1], m[3][2]);
+    float w = c[3] - radius * wrow.norm();
+    if (w < NEAR_W)
+    {
+        return 0;
+    }
+    float scale = 0;
+    for (int i = 0; i < 2; i++)
+    {
+        Vec3f row = Vec3f(m[i][0], m[i][1], m[i][2]) - wrow * (c[i] / c[3]);
+        scale = std::max(scale, row.norm() / w);
+    }
+
+    int level = 0;
+    while (level + 1 < model.nlods() && model.lod_error(level + 1) * scale <= maxerror)
+    {
+        level++;
+    }
+    return level;
+}
+
+int clip_triangle(const ScreenVertex &a, const ScreenVertex &b, const ScreenVertex &c, int width, 
+    int height, Vec3f *polygon)
+{
+    // entirely outside one plane
+    if (a.outcode & b.outcode & c.outcode)
+    {
+        return 0;
+    }
+
+    // entirely inside, the vertex stage already did the divide
+    unsigned int planes = a.outcode | b.outcode | c.outcode;
+    if (!planes)
+    {
+        polygon[0] = a.screen;
+        polygon[1] = b.screen;
+        polygon[2] = c.screen;
+        return 3;
+    }
+
+    // Sutherland-Hodgman against the planes some vertex is outside of; each
+    // plane adds at most one vertex
+    Vec4f buffers[2][3 + NPLANES];
+    Vec4f *in = buffers[0];
+    Vec4f *out = buffers[1];
+    int n = 3;
+    in[0] = a.clip;
+    in[1] = b.clip;
+    in[2] = c.clip;
+
+    for (int p = 0; p < NPLANES && n > 0; p++)
+    {
+        if (!(planes & (1 << p)))
+        {
+            continue;
+        }
+
+        float d[3 + NPLANES];
+        for (int i = 0; i < n; i++)
+        {
+            float all[NPLANES];
+            plane_distances(in[i], width, height, all);
+            d[i] = all[p];
+        }
+
+        int m = 0;
+        for (int i = 0; i < n; i++)
+        {
+            int j = (i + 1) % n;
+            if (d[i] >= 0)
+            {
+                out[m++] = in[i];
+                if (d[j] < 0)
+                {
+                    out[m++] = intersect(in[i], d[i], in[j], d[j]);
+                }
+            }
+            else if (d[j] >= 0)
+            {
+                out[m++] = intersect(in[j], d[j], in[i], d[i]);
+            }
+        }
+        std::swap(in, out);
+        n = m;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        polygon[i] = divide(in[i]);
+    }
+    return n < 3 ? 0 : n;
+}
+
+bool clip_segment(const ScreenVertex &a, const ScreenVertex &b, int width, int height, Vec3f &p0, 
+    Vec3f &p1)
+{
+    if (a.outcode & b.outcode)
+    {
+        return false;
+    }
+    if (!(a.outcode | b.outcode))
+    {
+        p0 = a.screen;
+        p1 = b.screen;
+        return true;
+    }
+
+    // keep the part t0..t1 of a + t * (b - a)
+    float da[NPLANES], db[NPLANES];
+    plane_distances(a.clip, width, height, da);
+    plane_distances(b.clip, width, height, db);
+    float t0 = 0, t1 = 1;
+    for (int p = 0; p < NPLANES; p++)
+    {
+        if (da[p] < 0 && db[p] < 0)
+        {
+            return false;
+        }
+        if (da[p] < 0)
+        {
+            t0 = std::max(t0, da[p] / (da[p] - db[p]));
+        }
+        else if (db[p] < 0)
+        {
+            t1 = std::min(t1, da[p] / (da[p] - db[p]));
+        }
+    }
+    if (t0 > t1)
+    {
+        return false;
+    }
+
+    p0 = divide(a.clip + (b.clip - a.clip) * t0);
+    p1 = divide(a.clip + (b.clip - a.clip) * t1);
+    return true;
+}
+
+void draw_triangle(Rasterizer &rasterizer, const ScreenVertex &a, const ScreenVertex &b, 
+    const ScreenVertex &c, TGAColor color)
+{
+    Vec3f polygon[3 + NPLANES];
+    int n = clip_triangle(a, b, c, rasterizer.get_width(), rasterizer.get_height(), polygon);
+    for (int i = 1; i + 1 < n; i++)
+    {
+        Vec3f pts[3] = { polygon[0], polygon[i], polygon[i + 1] };
+        rasterizer.triangle(pts, color);
+    }
+}
+
+void draw_triangle(Rasterizer &rasterizer, VisibilityBuffer &vbuffer, const ScreenVertex &a, 
+    const ScreenVertex &b, const ScreenVertex &c, unsigned int id)
+{
+    Vec3f polygon[3 + NPLANES];
+    int n = clip_triangle(a, b, c, rasterizer.get_width(), rasterizer.get_height(), polygon);
+    if (n == 0)
+    {
+        return;
+    }
+
+    // shading works from the unclipped triangle
+    Vec4f clip[3] = { a.clip, b.clip, c.clip };
+    vbuffer.set_triangle(id, clip);
+    for (int i = 1; i + 1 < n; i++)
+    {
+        Vec3f pts[3] = { polygon[0], polygon[i], polygon[i + 1] };
+        rasterizer.triangle(pts, id);
+    }
+}
+
+void draw_instances(Rasterizer &rasterizer, const Model &model, const Matrix &view, const Instance *instances, 
+    int n, Vec3f lightDir, float maxerror)
+{
+    int width = rasterizer.get_width();
+    int height = rasterizer.get_height();
+    Vec3f lo, hi;
+    model.bounds(lo, hi);
+    Vec3f center = (lo + hi) * 0.5f;
+    float radius = (hi - lo).norm() * 0.5f;
+
+    // the screen vertices of the instance's level of detail are rebuilt for
+    // every instance, the triangles queued from them keep their own copies
+    std::vector<ScreenVertex> verts;
+    for (int k = 0; k < n; k++)
+    {
+        Matrix m = view * instances[k].transform;
+        if (sphere_outside(center, radius, m, width, height))
+        {
+            continue;
+        }
+        int level = select_lod(model, m, maxerror);
+        Matrix inverse = instances[k].transform;
+        Vec3f light = proj<3>(inverse.invert() * embed<4>(lightDir, 0.f));
+        light = light * (lightDir.norm() / light.norm());
+        transform_vertices(model, level, m, width, height, verts);
+
+        const TGAColor &color = instances[k].color;
+        for (int i = 0; i < model.lod_nfaces(level); i++)
+        {
+            float intensity = model.lod_normal(level, i) * light;
+            if (intensity > 0)
+            {
+                Vec3i face = model.lod_face(level, i);
+                draw_triangle(rasterizer, verts[face[0]], verts[face[1]], verts[face[2]], 
+                    TGAColor(color.rgba[0] * intensity, color.rgba[1] * intensity, color.rgba[2] * intensity, 
+                    color.rgba[3]));
+            }
+        }
+    }
+}
@@ -0,0 +1,118 @@
+/**
+ * Header file for the vertex stage of the render pipeline.
+ */
+
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include <vector>
+#include "geometry.h"
+#include "model.h"
+#include "rasterizer.h"
+#include "vbuffer.h"
+
+// how far in pixels screen coordinates may stray past the image before
+// triangles get clipped; inside it the rasterizer's fixed point setup
+// cannot overflow, and outside of it only the near plane needs clipping
+const float GUARD_BAND = 8192;
+
+// vertices closer to the camera plane than this (in w) are clipped away
+const float NEAR_W = 1e-5f;
+
+// a vertex after the vertex stage
+struct ScreenVertex
+{
+    Vec4f clip;            // homogeneous screen coordinates, before the perspective divide
+    Vec3f screen;          // x and y in pixels and depth, after the divide
+    unsigned int outcode;  // a bit for every clip plane the vertex is outside of
+};
+
+// maps normalized coordinates in [-1, 1] to a w x h pixel area at (x, y),
+// depth is left as it is
+Matrix viewport(int x, int y, int w, int h);
+
+// perspective projection for a camera c units from the origin along z,
+// c = 0 gives an orthographic view
+Matrix projection(float c);
+
+// rotation by angle radians around the y axis
+Matrix rotation_y(float angle);
+
+// camera looking from eye towards center
+Matrix lookat(Vec3f eye, Vec3f center, Vec3f up);
+
+// transforms positions [begin, end) by m for a width x height image and
+// stores them to verts[begin, end)
+void transform_vertices(const Vec3f *positions, const Matrix &m, int width, int height, ScreenVertex *verts, 
+    int begin, int end);
+
+// transforms vertices [begin, end) of the model by m (usually
+// viewport * projection * modelview) for a width x height image and
+// stores them to verts[begin, end)
+void transform_vertices(const Model &model, const Matrix &m, int width, int height, ScreenVertex *verts, 
+    int begin, int end);
+
+// transforms every vertex of the model once, so faces only need to look
+// up their corners by index
+void transform_vertices(const Model &model, const Matrix &m, int width, int height, 
+    std::vector<ScreenVertex> &verts);
+
+// the same for only the vertices a level of detail uses, which its faces
+// index (see Model::lod_verts())
+void transform_vertices(const Model &model, int level, const Matrix &m, int width, int height, 
+    std::vector<ScreenVertex> &verts);
+
+// true if no face of the meshlet can have n * dir > 0, so the whole
+// cluster is back-facing with respect to dir
+bool meshlet_backfacing(const Meshlet &meshlet, Vec3f dir);
+
+// true if the sphere, transformed by m, lies entirely outside the width x
+// height image or behind the near plane
+bool sphere_outside(Vec3f center, float radius, const Matrix &m, int width, int height);
+
+// the same for the bounding sphere of a meshlet
+bool meshlet_outside(const Meshlet &meshlet, const Matrix &m, int width, int height);
+
+// picks the coarsest level of detail of the model whose error, projected
+// by m where the model's bounding sphere comes closest to the camera, stays
+// within maxerror pixels
+int select_lod(const Model &model, const Matrix &m, float maxerror);
+
+// clips a triangle against the near plane and the guard band of a width x
+// height image, writes the convex polygon that is left in screen space to
+// polygon (room for 8 vertices) and returns its number of vertices
+int clip_triangle(const ScreenVertex &a, const ScreenVertex &b, const ScreenVertex &c, int width, 
+    int height, Vec3f *polygon);
+
+// clips a segment the same way, returns false if nothing is left
+bool clip_segment(const ScreenVertex &a, const ScreenVertex &b, int width, int height, Vec3f &p0, 
+    Vec3f &p1);
+
+// clips a triangle and queues the pieces that are left on the rasterizer
+void draw_triangle(Rasterizer &rasterizer, const ScreenVertex &a, const ScreenVertex &b, 
+    const ScreenVertex &c, TGAColor color);
+
+// the same for a rasterizer drawing into vbuffer, also recording the
+// triangle there for shading
+void draw_triangle(Rasterizer &rasterizer, VisibilityBuffer &vbuffer, const ScreenVertex &a, 
+    const ScreenVertex &b, const ScreenVertex &c, unsigned int id);
+
+// one copy of a model in an instanced draw: the matrix that places it in
+// front of the shared view transform, and its color
+struct Instance
+{
+    Matrix transform;
+    TGAColor color;
+};
+
+// queues n instances of the model on the rasterizer, each face flat lit
+// from lightDir in its instance's color; the index buffer and face normals
+// are shared, instances outside the image are skipped whole and the rest
+// use the coarsest level of detail within maxerror pixels; instance
+// transforms are expected to be rotations, translations and uniform
+// scales, since the light is moved into model space once per instance
+// instead of moving every normal out of it
+void draw_instances(Rasterizer &rasterizer, const Model &model, const Matrix &view, const Instance *instances, 
+    int n, Vec3f lightDir, float maxerror);
+
+#endif //__PIPELINE_H__
@@ -0,0 +1,469 @@
+/**
+ * Triangle rasterization, either straight onto the image or binned into
+ * screen tiles that are drawn by a pool of threads.
+ */
+
+#include <cmath>
+#include <climits>
+#include <cfloat>
+#include <string.h>
+#include <algorithm>
+#include "rasterizer.h"
+#include "rasterkernel.h"
+
+// rounds a / b towards negative infinity (b > 0)
+static long long floor_div(long long a, long long b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// fits a plane through the values at the three snapped vertices and returns
+// its value at the center of pixel (0, 0) and its steps per pixel
+static void setup_plane(long long *X, long long *Y, long long area, float *V, float &v, float &dvdx, 
+    float &dvdy)
+{
+    const double one = 1 << SUBPIXEL_BITS;
+    double dx = ((V[1] - V[0]) * (double)(Y[2] - Y[0]) - (V[2] - V[0]) * (double)(Y[1] - Y[0])) / area * one;
+    double dy = ((V[2] - V[0]) * (double)(X[1] - X[0]) - (V[1] - V[0]) * (double)(X[2] - X[0])) / area * one;
+    v = (float)(V[0] + dx * (0.5 - X[0] / one) + dy * (0.5 - Y[0] / one));
+    dvdx = (float)dx;
+    dvdy = (float)dy;
+}
+
+bool setup_triangle(Vec3f *pts, TGAColor color, int width, int height, RasterTriangle &t)
+{
+    TGAColor colors[3] = { color, color, color };
+    return setup_triangle(pts, colors, width, height, t);
+}
+
+bool setup_triangle(Vec3f *pts, TGAColor *colors, int width, int height, RasterTriangle &t)
+{
+    const long long one = 1 << SUBPIXEL_BITS;
+    long long X[3], Y[3];
+    float Z[3];
+    TGAColor C[3];
+    for (int i = 0; i < 3; i++)
+    {
+        X[i] = std::llround(pts[i].x * one);
+        Y[i] = std::llround(pts[i].y * one);
+        Z[i] = pts[i].z;
+        C[i] = colors[i];
+    }
+
+    // twice the signed area; zero means the snapped vertices are collinear
+    long long area = (X[1] - X[0]) * (Y[2] - Y[0]) - (Y[1] - Y[0]) * (X[2] - X[0]);
+    if (area == 0)
+    {
+        return false;
+    }
+
+    // both windings are drawn, flip clockwise triangles around
+    if (area < 0)
+    {
+        std::swap(X[1], X[2]);
+        std::swap(Y[1], Y[2]);
+        std::swap(Z[1], Z[2]);
+        std::swap(C[1], C[2]);
+        area = -area;
+    }
+
+    // bounding box of the pixels whose centers can be covered
+    long long minx = std::min(X[0], std::min(X[1], X[2]));
+    long long miny = std::min(Y[0], std::min(Y[1], Y[2]));
+    long long maxx = std::max(X[0], std::max(X[1], X[2]));
+    long long maxy = std::max(Y[0], std::max(Y[1], Y[2]));
+    t.bboxmin.x = (int)std::max(0LL, floor_div(minx - one / 2 + one - 1, one));
+    t.bboxmin.y = (int)std::max(0LL, floor_div(miny - one / 2 + one - 1, one));
+    t.bboxmax.x = (int)std::min((long long)width - 1, floor_div(maxx - one / 2, one));
+    t.bboxmax.y = (int)std::min((long long)height - 1, floor_div(maxy - one / 2, one));
+    if (t.bboxmin.x > t.bboxmax.x || t.bboxmin.y > t.bboxmax.y)
+    {
+        return false;
+    }
+
+    // edge i runs between the two vertices other than i and is positive on
+    // the inside; pixels exactly on an edge only belong to the triangle if it
+    // is a top or left edge, so shared edges are drawn exactly once
+    t.fits32 = true;
+    for (int i = 0; i < 3; i++)
+    {
+        int a = (i + 1) % 3;
+        int b = (i + 2) % 3;
+        long long A = Y[a] - Y[b];
+        long long B = X[b] - X[a];
+        bool topleft = A > 0 || (A == 0 && B < 0);
+        t.e[i] = A * (one / 2) + B * (one / 2) - A * X[a] - B * Y[a] + (topleft ? 0 : -1);
+        t.dx[i] = A * one;
+        t.dy[i] = B * one;
+
+        // the edge is linear, so its largest values are at the box corners
+        for (int corner = 0; corner < 4; corner++)
+        {
+            long long x = corner & 1 ? t.bboxmax.x : t.bboxmin.x;
+            long long y = corner & 2 ? t.bboxmax.y : t.bboxmin.y;
+            long long e = t.e[i] + t.dx[i] * x + t.dy[i] * y;
+            t.fits32 = t.fits32 && e > INT_MIN && e < INT_MAX;
+        }
+    }
+
+    // depth and color are planes over the pixel centers
+    setup_plane(X, Y, area, Z, t.z, t.dzdx, t.dzdy);
+    t.zmin = std::min(Z[0], std::min(Z[1], Z[2]));
+    t.zmax = std::max(Z[0], std::max(Z[1], Z[2]));
+    t.zeps = 4 * FLT_EPSILON * (std::abs(t.z) + std::abs(t.dzdx) * t.bboxmax.x + 
+        std::abs(t.dzdy) * t.bboxmax.y) + FLT_MIN;
+    t.color = C[0];
+    t.flat = true;
+    for (int i = 1; i < 3; i++)
+    {
+        t.flat = t.flat && !memcmp(C[i].rgba, C[0].rgba, sizeof(C[0].rgba));
+    }
+    for (int k = 0; k < 4; k++)
+    {
+        float V[3] = { (float)C[0][k], (float)C[1][k], (float)C[2][k] };
+        setup_plane(X, Y, area, V, t.c[k], t.dcdx[k], t.dcdy[k]);
+    }
+    return true;
+}
+
+// returns true if the pixels in [x0, x1] x [y0, y1] are all outside one of the edges
+static bool block_outside(const RasterTriangle &t, int x0, int y0, int x1, int y1)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        // the corner where the edge value is largest
+        long long x = t.dx[i] >= 0 ? x1 : x0;
+        long long y = t.dy[i] >= 0 ? y1 : y0;
+        if (t.e[i] + t.dx[i] * x + t.dy[i] * y < 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// what the zbuffer says about a triangle over one block
+enum BlockDepth
+{
+    BLOCK_HIDDEN,   // no pixel can pass the depth test
+    BLOCK_TEST,     // pixels need the depth test
+    BLOCK_VISIBLE   // every pixel passes the depth test
+};
+
+static BlockDepth classify_block(const RasterTriangle &t, int x0, int y0, int x1, int y1, int bx, int by,
+    ZBuffer &zbuffer)
+{
+    if (block_outside(t, x0, y0, x1, y1))
+    {
+        return BLOCK_HIDDEN;
+    }
+
+    // depth range of the triangle over the block; depth is a plane, so its
+    // extremes are at the corners
+    float zlo = t.zmax;
+    float zhi = t.zmin;
+    for (int corner = 0; corner < 4; corner++)
+    {
+        float z = t.z + t.dzdx * (corner & 1 ? x1 : x0) + t.dzdy * (corner & 2 ? y1 : y0);
+        zlo = std::min(zlo, z);
+        zhi = std::max(zhi, z);
+    }
+    zlo = std::max(zlo, t.zmin) - t.zeps;
+    zhi = std::min(zhi, t.zmax) + t.zeps;
+
+    // everything behind the farthest pixel of the block is hidden, and
+    // everything in front of the closest one needs no depth test
+    if (zhi <= zbuffer.block_far(bx, by))
+    {
+        return BLOCK_HIDDEN;
+    }
+    return zlo > zbuffer.block_near(bx, by) ? BLOCK_VISIBLE : BLOCK_TEST;
+}
+
+// draws a flat triangle inside [xmin, xmax] x [ymin, ymax], which lies
+// within one tile, as one covered span per row, filled with contiguous
+// copies of its color
+static bool raster_spans(const RasterTriangle &t, int xmin, int ymin, int xmax, int ymax, ZBuffer &zbuffer, 
+    unsigned char *pixels, int bytespp)
+{
+    unsigned char pattern[SPAN_PATTERN * 4];
+    for (int i = 0; i < SPAN_PATTERN; i++)
+    {
+        memcpy(pattern + i * bytespp, t.color.rgba, bytespp);
+    }
+
+    int width = zbuffer.get_width();
+    int bx0 = xmin / ZBLOCK_SIZE;
+    int nblocks = xmax / ZBLOCK_SIZE - bx0 + 1;
+    BlockDepth blocks[TILE_SIZE / ZBLOCK_SIZE + 1];
+    bool dirty[TILE_SIZE / ZBLOCK_SIZE + 1];
+    bool written = false;
+
+    for (int by = ymin / ZBLOCK_SIZE; by <= ymax / ZBLOCK_SIZE; by++)
+    {
+        int y0 = std::max(by * ZBLOCK_SIZE, ymin);
+        int y1 = std::min(by * ZBLOCK_SIZE + ZBLOCK_SIZE - 1, ymax);
+
+        // classify the blocks of this band of rows once
+        bool any = false;
+        for (int i = 0; i < nblocks; i++)
+        {
+            int x0 = std::max((bx0 + i) * ZBLOCK_SIZE, xmin);
+            int x1 = std::min((bx0 + i) * ZBLOCK_SIZE + ZBLOCK_SIZE - 1, xmax);
+            blocks[i] = classify_block(t, x0, y0, x1, y1, bx0 + i, by, zbuffer);
+            any = any || blocks[i] != BLOCK_HIDDEN;
+            dirty[i] = false;
+        }
+        if (!any)
+        {
+            continue;
+        }
+
+        for (int y = y0; y <= y1; y++)
+        {
+            int left = xmin, right = xmax;
+            if (!row_span(t, y, left, right))
+            {
+                continue;
+            }
+
+            // walk the span in runs of blocks that were classified the same
+            for (int x = left; x <= right; )
+            {
+                int first = x / ZBLOCK_SIZE - bx0;
+                int last = first;
+                while ((last + 1 + bx0) * ZBLOCK_SIZE <= right && blocks[last + 1] == blocks[first])
+                {
+                    last++;
+                }
+                int end = std::min(right, (last + 1 + bx0) * ZBLOCK_SIZE - 1);
+
+                if (blocks[first] != BLOCK_HIDDEN && raster_span(t, y, x, end, zbuffer.buffer() + y * width, 
+                    pixels + y * width * bytespp, pattern, bytespp, blocks[first] == BLOCK_TEST))
+                {
+                    for (int i = first; i <= last; i++)
+                    {
+                        dirty[i] = true;
+                    }
+                }
+                x = end + 1;
+            }
+        }
+
+        for (int i = 0; i < nblocks; i++)
+        {
+            if (dirty[i])
+            {
+                zbuffer.update_block(bx0 + i, by);
+                written = true;
+            }
+        }
+    }
+    return written;
+}
+
+// draws the part of a triangle that falls inside [rectmin, rectmax] into
+// pixels laid out like the zbuffer, returns true if any pixel was written;
+// flat triangles are filled span by span, others one block at a time
+static bool raster_rect(const RasterTriangle &t, Vec2i rectmin, Vec2i rectmax, ZBuffer &zbuffer, 
+    unsigned char *pixels, int bytespp)
+{
+    int xmin = std::max(t.bboxmin.x, rectmin.x);
+    int ymin = std::max(t.bboxmin.y, rectmin.y);
+    int xmax = std::min(t.bboxmax.x, rectmax.x);
+    int ymax = std::min(t.bboxmax.y, rectmax.y);
+    int width = zbuffer.get_width();
+    bool written = false;
+
+    // spans are drawn a tile wide at a time, so the state of their blocks
+    // fits on the stack
+    if (t.flat)
+    {
+        for (int x = xmin; x <= xmax; x = (x / TILE_SIZE + 1) * TILE_SIZE)
+        {
+            int end = std::min(xmax, (x / TILE_SIZE + 1) * TILE_SIZE - 1);
+            written = raster_spans(t, x, ymin, end, ymax, zbuffer, pixels, bytespp) || written;
+        }
+        return written;
+    }
+
+    for (int by = ymin / ZBLOCK_SIZE; by <= ymax / ZBLOCK_SIZE; by++)
+    {
+        int y0 = std::max(by * ZBLOCK_SIZE, ymin);
+        int y1 = std::min(by * ZBLOCK_SIZE + ZBLOCK_SIZE - 1, ymax);
+        for (int bx = xmin / ZBLOCK_SIZE; bx <= xmax / ZBLOCK_SIZE; bx++)
+        {
+            int x0 = std::max(bx * ZBLOCK_SIZE, xmin);
+            int x1 = std::min(bx * ZBLOCK_SIZE + ZBLOCK_SIZE - 1, xmax);
+            BlockDepth depth = classify_block(t, x0, y0, x1, y1, bx, by, zbuffer);
+            if (depth != BLOCK_HIDDEN && raster_block(t, x0, y0, x1, y1, zbuffer.buffer(), pixels, width, 
+                bytespp, depth == BLOCK_TEST))
+            {
+                zbuffer.update_block(bx, by);
+                written = true;
+            }
+        }
+    }
+    return written;
+}
+
+void triangle(Vec3f *pts, ZBuffer &zbuffer, TGAImage &image, TGAColor color)
+{
+    RasterTriangle t;
+    if (!setup_triangle(pts, color, image.get_width(), image.get_height(), t))
+    {
+        return;
+    }
+
+    if (raster_rect(t, Vec2i(0, 0), Vec2i(image.get_width() - 1, image.get_height() - 1), zbuffer, 
+        image.buffer(), image.get_bytespp()))
+    {
+        for (int ty = t.bboxmin.y / ZTILE_SIZE; ty <= t.bboxmax.y / ZTILE_SIZE; ty++)
+        {
+            for (int tx = t.bboxmin.x / ZTILE_SIZE; tx <= t.bboxmax.x / ZTILE_SIZE; tx++)
+            {
+                zbuffer.update_tile(tx, ty);
+            }
+        }
+    }
+}
+
+Rasterizer::Rasterizer(TGAImage &image, ZBuffer &zbuffer, int nthreads) : image_(&image), vbuffer_(NULL), 
+    zbuffer_(zbuffer), pool_(NULL), owned_(false), triangles_(), bins_()
+{
+    start(nthreads);
+}
+
+Rasterizer::Rasterizer(VisibilityBuffer &vbuffer, ZBuffer &zbuffer, int nthreads) : image_(NULL), 
+    vbuffer_(&vbuffer), zbuffer_(zbuffer), pool_(NULL), owned_(false), triangles_(), bins_()
+{
+    start(nthreads);
+}
+
+// picks the threads to draw with and sets up the tile bins
+void Rasterizer::start(int nthreads)
+{
+    owned_ = nthreads > 0;
+    pool_ = owned_ ? new ThreadPool(nthreads) : &default_thread_pool();
+    tilesx_ = (zbuffer_.get_width() + TILE_SIZE - 1) / TILE_SIZE;
+    tilesy_ = (zbuffer_.get_height() + TILE_SIZE - 1) / TILE_SIZE;
+    bins_.resize(tilesx_ * tilesy_);
+}
+
+// destructor
+Rasterizer::~Rasterizer()
+{
+    if (owned_)
+    {
+        delete pool_;
+    }
+}
+
+// returns the number of threads drawing tiles
+int Rasterizer::nthreads()
+{
+    return pool_->size();
+}
+
+int Rasterizer::get_width()
+{
+    return zbuffer_.get_width();
+}
+
+int Rasterizer::get_height()
+{
+    return zbuffer_.get_height();
+}
+
+void Rasterizer::triangle(Vec3f *pts, TGAColor color)
+{
+    TGAColor colors[3] = { color, color, color };
+    triangle(pts, colors);
+}
+
+// sets up a triangle and adds it to the bin of every tile its bounding box touches
+void Rasterizer::triangle(Vec3f *pts, TGAColor *colors)
+{
+    RasterTriangle t;
+    if (!setup_triangle(pts, colors, zbuffer_.get_width(), zbuffer_.get_height(), t))
+    {
+        return;
+    }
+    bin_triangle(t);
+}
+
+// draws the id of a triangle into the visibility buffer
+void Rasterizer::triangle(Vec3f *pts, unsigned int id)
+{
+    RasterTriangle t;
+    if (!setup_triangle(pts, TGAColor((unsigned char *)&id, sizeof(id)), zbuffer_.get_width(), 
+        zbuffer_.get_height(), t))
+    {
+        return;
+    }
+    bin_triangle(t);
+}
+
+void Rasterizer::bin_triangle(const RasterTriangle &t)
+{
+    int idx = (int)triangles_.size();
+    triangles_.push_back(t);
+    for (int ty = t.bboxmin.y / TILE_SIZE; ty <= t.bboxmax.y / TILE_SIZE; ty++)
+    {
+        for (int tx = t.bboxmin.x / TILE_SIZE; tx <= t.bboxmax.x / TILE_SIZE; tx++)
+        {
+            bins_[tx + ty * tilesx_].push_back(idx);
+        }
+    }
+}
+
+// draws every queued triangle; each tile only touches its own pixels, so
+// the threads never need to lock
+void Rasterizer::flush()
+{
+    unsigned char *pixels = image_ ? image_->buffer() : (unsigned char *)vbuffer_->buffer();
+    int bytespp = image_ ? image_->get_bytespp() : (int)sizeof(unsigned int);
+    pool_->parallel_for((int)bins_.size(), [&](int tile) { raster_tile(tile, pixels, bytespp); });
+
+    triangles_.clear();
+    for (size_t i = 0; i < bins_.size(); i++)
+    {
+        bins_[i].clear();
+    }
+}
+
+// shades every pixel of the visibility buffer once, in bands of rows
+void Rasterizer::shade(IShader &shader, TGAImage &image)
+{
+    int height = vbuffer_->get_height();
+    int nbands = (height + TILE_SIZE - 1) / TILE_SIZE;
+    pool_->parallel_for(nbands, [&](int band) 
+    {
+        vbuffer_->shade(shader, image, band * TILE_SIZE, std::min(height, (band + 1) * TILE_SIZE) - 1);
+    });
+}
+
+void Rasterizer::raster_tile(int tile, unsigned char *pixels, int bytespp)
+{
+    Vec2i tilemin((tile % tilesx_) * TILE_SIZE, (tile / tilesx_) * TILE_SIZE);
+    Vec2i tilemax(tilemin.x + TILE_SIZE - 1, tilemin.y + TILE_SIZE - 1);
+    const std::vector<int> &bin = bins_[tile];
+
+    int tx = tile % tilesx_;
+    int ty = tile / tilesx_;
+
+    for (size_t i = 0; i < bin.size(); i++)
+    {
+        // skip triangles that are entirely behind everything in the tile
+        const RasterTriangle &t = triangles_[bin[i]];
+        if (t.zmax + t.zeps <= zbuffer_.tile_far(tx, ty))
+        {
+            continue;
+        }
+
+        if (raster_rect(t, tilemin, tilemax, zbuffer_, pixels, bytespp))
+        {
+            zbuffer_.update_tile(tx, ty);
+        }
+    }
+}
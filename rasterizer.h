@@ -0,0 +1,92 @@
+/**
+ * Header file for the triangle rasterizer.
+ */
+
+#ifndef __RASTERIZER_H__
+#define __RASTERIZER_H__
+
+#include <vector>
+#include "tgaimage.h"
+#include "geometry.h"
+#include "threadpool.h"
+#include "zbuffer.h"
+#include "vbuffer.h"
+
+// width and height in pixels of the screen tiles triangles are binned into,
+// the same as the zbuffer tiles so a tile's depth range belongs to one thread
+const int TILE_SIZE = ZTILE_SIZE;
+
+// vertex positions are snapped to 1/16th of a pixel before rasterization
+const int SUBPIXEL_BITS = 4;
+
+// a triangle set up for rasterization: three integer edge functions plus
+// planes for depth and color, all evaluated at pixel centers; a pixel (x, y)
+// is covered when every e[i] + x * dx[i] + y * dy[i] is >= 0
+struct RasterTriangle
+{
+    long long e[3];   // edge values at pixel (0, 0), fill rule bias included
+    long long dx[3];  // edge steps for one pixel to the right
+    long long dy[3];  // edge steps for one row down
+    float z, dzdx, dzdy;
+    float zmin, zmax; // depth range of the vertices
+    float zeps;       // bound on the rounding error of depth values
+    float c[4], dcdx[4], dcdy[4];  // color channel planes, unused when flat
+    Vec2i bboxmin;
+    Vec2i bboxmax;
+    TGAColor color;
+    bool flat;        // all three vertices have the same color
+    bool fits32;      // edge values inside the bounding box fit in an int
+};
+
+// sets up a triangle with screen space vertices (x and y in pixels, z is
+// depth) and a color per vertex, returns false if it is degenerate or
+// covers no pixel of the image
+bool setup_triangle(Vec3f *pts, TGAColor *colors, int width, int height, RasterTriangle &t);
+bool setup_triangle(Vec3f *pts, TGAColor color, int width, int height, RasterTriangle &t);
+
+// draws a triangle straight away on the calling thread
+void triangle(Vec3f *pts, ZBuffer &zbuffer, TGAImage &image, TGAColor color);
+
+// collects triangles into screen tiles and rasterizes the tiles in parallel;
+// every pixel sees its triangles in submission order, so the image and
+// zbuffer come out the same as calling triangle() for each one in turn;
+// triangles and blocks that the zbuffer shows to be hidden are skipped;
+// drawing into a visibility buffer stores triangle ids instead of colors
+// and shade() then colors each visible pixel exactly once
+class Rasterizer
+{
+private:
+    TGAImage *image_;
+    VisibilityBuffer *vbuffer_;
+    ZBuffer &zbuffer_;
+    ThreadPool *pool_;
+    bool owned_;  // pool_ was started for this rasterizer alone
+    int tilesx_;
+    int tilesy_;
+    std::vector<RasterTriangle> triangles_;
+    std::vector<std::vector<int> > bins_;
+    void bin_triangle(const RasterTriangle &t);
+    void raster_tile(int tile, unsigned char *pixels, int bytespp);
+    void start(int nthreads);
+    Rasterizer(const Rasterizer &);
+    Rasterizer &operator=(const Rasterizer &);
+public:
+    // nthreads 0 draws with default_thread_pool(), so rasterizers made one
+    // after the other reuse the same threads; 1 draws on the calling thread
+    // alone, and more starts a pool of that size for this rasterizer
+    Rasterizer(TGAImage &image, ZBuffer &zbuffer, int nthreads = 0);
+    Rasterizer(VisibilityBuffer &vbuffer, ZBuffer &zbuffer, int nthreads = 0);
+    ~Rasterizer();
+    int nthreads();
+    int get_width();
+    int get_height();
+
+    // vertices must lie within the guard band, see clip_triangle()
+    void triangle(Vec3f *pts, TGAColor color);
+    void triangle(Vec3f *pts, TGAColor *colors);
+    void triangle(Vec3f *pts, unsigned int id);
+    void flush();
+    void shade(IShader &shader, TGAImage &image);
+};
+
+#endif //__RASTERIZER_H__
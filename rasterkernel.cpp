@@ -0,0 +1,348 @@
+/**
+ * Row kernels for the rasterizer: a plain scalar loop plus SSE2 and AVX2
+ * versions that handle 4 or 8 neighbouring pixels at a time. The vector
+ * kernels do the same arithmetic per pixel as the scalar one, so every
+ * level draws exactly the same image.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include "rasterkernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RASTER_X86
+#include <immintrin.h>
+#endif
+
+// writes one pixel, interpolating the color unless the triangle is flat
+static inline void shade_pixel(const RasterTriangle &t, int x, int y, unsigned char *pixel, int bytespp)
+{
+    if (t.flat)
+    {
+        memcpy(pixel, t.color.rgba, bytespp);
+        return;
+    }
+
+    for (int k = 0; k < bytespp; k++)
+    {
+        float v = (t.c[k] + t.dcdy[k] * y) + t.dcdx[k] * x;
+        v = std::min(std::max(v, 0.f), 255.f);
+        pixel[k] = (unsigned char)(int)(v + .5f);
+    }
+}
+
+static bool row_scalar(const RasterTriangle &t, int y, int x0, int x1, float *zrow, 
+    unsigned char *pixels, int bytespp, bool ztest)
+{
+    bool written = false;
+    long long e0 = t.e[0] + t.dx[0] * x0 + t.dy[0] * y;
+    long long e1 = t.e[1] + t.dx[1] * x0 + t.dy[1] * y;
+    long long e2 = t.e[2] + t.dx[2] * x0 + t.dy[2] * y;
+    float zy = t.z + t.dzdy * y;
+
+    for (int x = x0; x <= x1; x++)
+    {
+        // inside when none of the edge values is negative
+        if ((e0 | e1 | e2) >= 0)
+        {
+            // only draw the pixel if it is closer than what is already there
+            float z = zy + t.dzdx * x;
+            if (!ztest || zrow[x] < z)
+            {
+                zrow[x] = z;
+                shade_pixel(t, x, y, pixels + x * bytespp, bytespp);
+                written = true;
+            }
+        }
+        e0 += t.dx[0];
+        e1 += t.dx[1];
+        e2 += t.dx[2];
+    }
+    return written;
+}
+
+#ifdef RASTER_X86
+
+// writes the pixels whose bit is set in mask, lanes start at pixel x; the
+// lane colors in channels are only used when the triangle is not flat
+static inline void write_lanes(const RasterTriangle &t, int x, int mask, const int channels[4][8], 
+    unsigned char *pixels, int bytespp)
+{
+    for (; mask; mask &= mask - 1)
+    {
+        int i = __builtin_ctz(mask);
+        unsigned char *pixel = pixels + (x + i) * bytespp;
+        if (t.flat)
+        {
+            memcpy(pixel, t.color.rgba, bytespp);
+            continue;
+        }
+        for (int k = 0; k < bytespp; k++)
+        {
+            pixel[k] = (unsigned char)channels[k][i];
+        }
+    }
+}
+
+static bool row_sse2(const RasterTriangle &t, int y, int x0, int x1, float *zrow, 
+    unsigned char *pixels, int bytespp, bool ztest)
+{
+    if (!t.fits32)
+    {
+        return row_scalar(t, y, x0, x1, zrow, pixels, bytespp, ztest);
+    }
+
+    int e0 = (int)(t.e[0] + t.dx[0] * x0 + t.dy[0] * y);
+    int e1 = (int)(t.e[1] + t.dx[1] * x0 + t.dy[1] * y);
+    int e2 = (int)(t.e[2] + t.dx[2] * x0 + t.dy[2] * y);
+    int dx0 = (int)t.dx[0], dx1 = (int)t.dx[1], dx2 = (int)t.dx[2];
+    __m128i E0 = _mm_setr_epi32(e0, e0 + dx0, e0 + 2 * dx0, e0 + 3 * dx0);
+    __m128i E1 = _mm_setr_epi32(e1, e1 + dx1, e1 + 2 * dx1, e1 + 3 * dx1);
+    __m128i E2 = _mm_setr_epi32(e2, e2 + dx2, e2 + 2 * dx2, e2 + 3 * dx2);
+    __m128i step0 = _mm_set1_epi32(4 * dx0);
+    __m128i step1 = _mm_set1_epi32(4 * dx1);
+    __m128i step2 = _mm_set1_epi32(4 * dx2);
+    __m128 zy = _mm_set1_ps(t.z + t.dzdy * y);
+    __m128 dzdx = _mm_set1_ps(t.dzdx);
+    __m128 xs = _mm_cvtepi32_ps(_mm_setr_epi32(x0, x0 + 1, x0 + 2, x0 + 3));
+    __m128 four = _mm_set1_ps(4.f);
+    __m128i minus1 = _mm_set1_epi32(-1);
+    __m128 always = _mm_castsi128_ps(_mm_set1_epi32(ztest ? 0 : -1));
+    bool written = false;
+
+    // whole groups of four, the leftover pixels go through the scalar loop
+    int x = x0;
+    for (; x + 3 <= x1; x += 4)
+    {
+        __m128i inside = _mm_cmpgt_epi32(_mm_or_si128(_mm_or_si128(E0, E1), E2), minus1);
+        if (_mm_movemask_epi8(inside))
+        {
+            __m128 z = _mm_add_ps(zy, _mm_mul_ps(dzdx, xs));
+            __m128 zb = _mm_loadu_ps(zrow + x);
+            __m128 m = _mm_and_ps(_mm_castsi128_ps(inside), _mm_or_ps(always, _mm_cmpgt_ps(z, zb)));
+            int mask = _mm_movemask_ps(m);
+            if (mask)
+            {
+                written = true;
+                _mm_storeu_ps(zrow + x, _mm_or_ps(_mm_and_ps(m, z), _mm_andnot_ps(m, zb)));
+
+                // evaluate the color planes for all lanes, the same way shade_pixel() does
+                int channels[4][8];
+                for (int k = 0; !t.flat && k < bytespp; k++)
+                {
+                    __m128 v = _mm_add_ps(_mm_set1_ps(t.c[k] + t.dcdy[k] * y), 
+                        _mm_mul_ps(_mm_set1_ps(t.dcdx[k]), xs));
+                    v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(255.f));
+                    _mm_storeu_si128((__m128i *)channels[k], 
+                        _mm_cvttps_epi32(_mm_add_ps(v, _mm_set1_ps(.5f))));
+                }
+                write_lanes(t, x, mask, channels, pixels, bytespp);
+            }
+        }
+        E0 = _mm_add_epi32(E0, step0);
+        E1 = _mm_add_epi32(E1, step1);
+        E2 = _mm_add_epi32(E2, step2);
+        xs = _mm_add_ps(xs, four);
+    }
+
+    if (x <= x1 && row_scalar(t, y, x, x1, zrow, pixels, bytespp, ztest))
+    {
+        written = true;
+    }
+    return written;
+}
+
+__attribute__((target("avx2")))
+static bool row_avx2(const RasterTriangle &t, int y, int x0, int x1, float *zrow, 
+    unsigned char *pixels, int bytespp, bool ztest)
+{
+    if (!t.fits32)
+    {
+        return row_scalar(t, y, x0, x1, zrow, pixels, bytespp, ztest);
+    }
+
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i dx0 = _mm256_set1_epi32((int)t.dx[0]);
+    __m256i dx1 = _mm256_set1_epi32((int)t.dx[1]);
+    __m256i dx2 = _mm256_set1_epi32((int)t.dx[2]);
+    __m256i E0 = _mm256_add_epi32(_mm256_set1_epi32((int)(t.e[0] + t.dx[0] * x0 + t.dy[0] * y)), 
+        _mm256_mullo_epi32(lane, dx0));
+    __m256i E1 = _mm256_add_epi32(_mm256_set1_epi32((int)(t.e[1] + t.dx[1] * x0 + t.dy[1] * y)), 
+        _mm256_mullo_epi32(lane, dx1));
+    __m256i E2 = _mm256_add_epi32(_mm256_set1_epi32((int)(t.e[2] + t.dx[2] * x0 + t.dy[2] * y)), 
+        _mm256_mullo_epi32(lane, dx2));
+    __m256i step0 = _mm256_slli_epi32(dx0, 3);
+    __m256i step1 = _mm256_slli_epi32(dx1, 3);
+    __m256i step2 = _mm256_slli_epi32(dx2, 3);
+    __m256 zy = _mm256_set1_ps(t.z + t.dzdy * y);
+    __m256 dzdx = _mm256_set1_ps(t.dzdx);
+    __m256 xs = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x0), lane));
+    __m256 eight = _mm256_set1_ps(8.f);
+    __m256i minus1 = _mm256_set1_epi32(-1);
+    __m256 always = _mm256_castsi256_ps(_mm256_set1_epi32(ztest ? 0 : -1));
+    bool written = false;
+
+    for (int x = x0; x <= x1; x += 8)
+    {
+        // lanes past x1 belong to the next tile and must not be touched
+        __m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32(x1 - x + 1), lane);
+        __m256i inside = _mm256_cmpgt_epi32(_mm256_or_si256(_mm256_or_si256(E0, E1), E2), minus1);
+        inside = _mm256_and_si256(inside, valid);
+        if (!_mm256_testz_si256(inside, inside))
+        {
+            __m256 z = _mm256_add_ps(zy, _mm256_mul_ps(dzdx, xs));
+            __m256 zb = _mm256_maskload_ps(zrow + x, valid);
+            __m256 m = _mm256_and_ps(_mm256_castsi256_ps(inside), 
+                _mm256_or_ps(always, _mm256_cmp_ps(z, zb, _CMP_GT_OQ)));
+            int mask = _mm256_movemask_ps(m);
+            if (mask)
+            {
+                written = true;
+                _mm256_maskstore_ps(zrow + x, _mm256_castps_si256(m), z);
+
+                // evaluate the color planes for all lanes, the same way shade_pixel() does
+                int channels[4][8];
+                for (int k = 0; !t.flat && k < bytespp; k++)
+                {
+                    __m256 v = _mm256_add_ps(_mm256_set1_ps(t.c[k] + t.dcdy[k] * y), 
+                        _mm256_mul_ps(_mm256_set1_ps(t.dcdx[k]), xs));
+                    v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(255.f));
+                    _mm256_storeu_si256((__m256i *)channels[k], 
+                        _mm256_cvttps_epi32(_mm256_add_ps(v, _mm256_set1_ps(.5f))));
+                }
+                write_lanes(t, x, mask, channels, pixels, bytespp);
+            }
+        }
+        E0 = _mm256_add_epi32(E0, step0);
+        E1 = _mm256_add_epi32(E1, step1);
+        E2 = _mm256_add_epi32(E2, step2);
+        xs = _mm256_add_ps(xs, eight);
+    }
+    return written;
+}
+
+#endif
+
+typedef bool (*RowKernel)(const RasterTriangle &, int, int, int, float *, unsigned char *, int, bool);
+
+// the widest kernel the cpu supports
+static RowKernel detect_kernel()
+{
+#ifdef RASTER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return row_avx2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return row_sse2;
+    }
+#endif
+    return row_scalar;
+}
+
+// chosen once at startup and only read afterwards, so any number of
+// rasterizers can use it at once
+static const RowKernel row_kernel = detect_kernel();
+
+bool raster_block(const RasterTriangle &t, int x0, int y0, int x1, int y1, float *zbuffer, 
+    unsigned char *pixels, int width, int bytespp, bool ztest)
+{
+    bool written = false;
+    for (int y = y0; y <= y1; y++)
+    {
+        if (row_kernel(t, y, x0, x1, zbuffer + y * width, pixels + y * width * bytespp, bytespp, ztest))
+        {
+            written = true;
+        }
+    }
+    return written;
+}
+
+// rounds a / b towards negative infinity (b > 0)
+static long long floor_div(long long a, long long b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+bool row_span(const RasterTriangle &t, int y, int &x0, int &x1)
+{
+    long long left = x0;
+    long long right = x1;
+    for (int i = 0; i < 3; i++)
+    {
+        // solve ey + dx * x >= 0 for x
+        long long ey = t.e[i] + t.dy[i] * y;
+        if (t.dx[i] > 0)
+        {
+            left = std::max(left, -floor_div(ey, t.dx[i]));
+        }
+        else if (t.dx[i] < 0)
+        {
+            right = std::min(right, floor_div(ey, -t.dx[i]));
+        }
+        else if (ey < 0)
+        {
+            return false;
+        }
+    }
+    x0 = (int)left;
+    x1 = (int)right;
+    return left <= right;
+}
+
+// copies n pixels of the pattern to dst
+static inline void fill_pixels(unsigned char *dst, const unsigned char *pattern, int n, int bytespp)
+{
+    for (; n > SPAN_PATTERN; n -= SPAN_PATTERN, dst += SPAN_PATTERN * bytespp)
+    {
+        memcpy(dst, pattern, SPAN_PATTERN * bytespp);
+    }
+    memcpy(dst, pattern, n * bytespp);
+}
+
+bool raster_span(const RasterTriangle &t, int y, int x0, int x1, float *zrow, unsigned char *pixels, 
+    const unsigned char *pattern, int bytespp, bool ztest)
+{
+    float zy = t.z + t.dzdy * y;
+
+    // the whole span is in front, store all depths and fill it at once
+    if (!ztest)
+    {
+        for (int x = x0; x <= x1; x++)
+        {
+            zrow[x] = zy + t.dzdx * x;
+        }
+        fill_pixels(pixels + x0 * bytespp, pattern, x1 - x0 + 1, bytespp);
+        return true;
+    }
+
+    // otherwise fill each run of pixels that pass the depth test
+    bool written = false;
+    int run = -1;
+    for (int x = x0; x <= x1; x++)
+    {
+        float z = zy + t.dzdx * x;
+        if (zrow[x] < z)
+        {
+            zrow[x] = z;
+            if (run < 0)
+            {
+                run = x;
+            }
+        }
+        else if (run >= 0)
+        {
+            fill_pixels(pixels + run * bytespp, pattern, x - run, bytespp);
+            written = true;
+            run = -1;
+        }
+    }
+    if (run >= 0)
+    {
+        fill_pixels(pixels + run * bytespp, pattern, x1 - run + 1, bytespp);
+        written = true;
+    }
+    return written;
+}
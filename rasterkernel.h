@@ -0,0 +1,32 @@
+/**
+ * Header file for the per-row pixel kernels of the rasterizer.
+ */
+
+#ifndef __RASTERKERNEL_H__
+#define __RASTERKERNEL_H__
+
+#include "rasterizer.h"
+
+// depth tests and shades the pixels of a triangle inside [x0, x1] x [y0, y1];
+// zbuffer and pixels point at the start of the depth buffer and image and
+// width is the length of their rows; without ztest every covered pixel is
+// drawn, for when the caller knows they all pass; returns true if any
+// pixel was written
+bool raster_block(const RasterTriangle &t, int x0, int y0, int x1, int y1, float *zbuffer, 
+    unsigned char *pixels, int width, int bytespp, bool ztest);
+
+// finds the pixels x0..x1 of row y that a triangle covers, returns false
+// if there are none
+bool row_span(const RasterTriangle &t, int y, int &x0, int &x1);
+
+// number of pixels in the color pattern of raster_span()
+const int SPAN_PATTERN = 64;
+
+// depth tests and fills pixels x0..x1 of row y of a flat triangle, which
+// must all be covered; pattern holds the triangle's color SPAN_PATTERN
+// times over, so runs of pixels are copied in one go; returns true if any
+// pixel was written
+bool raster_span(const RasterTriangle &t, int y, int x0, int x1, float *zrow, unsigned char *pixels, 
+    const unsigned char *pattern, int bytespp, bool ztest);
+
+#endif //__RASTERKERNEL_H__
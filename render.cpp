@@ -0,0 +1,185 @@
+/**
+ * Whole frames: culling, the vertex stage, rasterization and shading of a
+ * model for one camera.
+ */
+
+#include <cmath>
+#include <vector>
+#include "render.h"
+#include "pipeline.h"
+#include "rasterizer.h"
+#include "vbuffer.h"
+#include "line.h"
+
+// looks up the corners of a face of a level of detail after the vertex
+// stage and returns its normal
+static Vec3f face_corners(const Model &model, int level, int i, const std::vector<ScreenVertex> &verts,
+    const ScreenVertex **corners)
+{
+    Vec3i face = model.lod_face(level, i);
+    for (int j = 0; j < 3; j++)
+    {
+        corners[j] = &verts[face[j]];
+    }
+    return model.lod_normal(level, i);
+}
+
+// lists the faces of a level of detail worth drawing in order; with
+// meshlets, clusters of the full model that face away from the light or lie
+// outside the image are skipped as a whole
+static std::vector<int> candidate_faces(const Model &model, int level, const Camera &camera, int width,
+    int height)
+{
+    std::vector<int> faces;
+    if (level || !model.nmeshlets())
+    {
+        for (int i = 0; i < model.lod_nfaces(level); i++)
+        {
+            faces.push_back(i);
+        }
+        return faces;
+    }
+
+    for (int i = 0; i < model.nmeshlets(); i++)
+    {
+        Meshlet meshlet = model.meshlet(i);
+        if (meshlet_backfacing(meshlet, camera.light) || meshlet_outside(meshlet, camera.transform, width, height))
+        {
+            continue;
+        }
+        for (int j = meshlet.first; j < meshlet.first + meshlet.nfaces; j++)
+        {
+            faces.push_back(model.meshlet_face(j));
+        }
+    }
+    return faces;
+}
+
+// lights every visible pixel with the normal of its face
+struct FaceShader : public IShader
+{
+    std::vector<Vec3f> normals;
+    Vec3f lightDir;
+
+    virtual bool fragment(unsigned int id, Vec3f /*bar*/, TGAColor &color)
+    {
+        float intensity = normals[id] * lightDir;
+        color = TGAColor(intensity * 255, intensity * 255, intensity * 255, 255);
+        return true;
+    }
+};
+
+// lights the texture instead of white if there is one, sampled
+// trilinearly at the mip level that fits the size of each face on screen
+struct TextureShader : public FaceShader
+{
+    const Texture *texture;
+    std::vector<Vec2f> uvs;     // three per face
+    std::vector<float> levels;  // mip level per face
+
+    TextureShader() : texture(NULL) {}
+
+    virtual bool fragment(unsigned int id, Vec3f bar, TGAColor &color)
+    {
+        if (!texture)
+        {
+            return FaceShader::fragment(id, bar, color);
+        }
+        const Vec2f *uv = &uvs[3 * (size_t)id];
+        TGAColor texel = texture->trilinear(uv[0] * bar.x + uv[1] * bar.y + uv[2] * bar.z, levels[id]);
+        if (texture->get_bytespp() == 1)
+        {
+            texel = TGAColor(texel[0], texel[0], texel[0]);
+        }
+        float intensity = normals[id] * lightDir;
+        color = TGAColor(texel[0] * intensity, texel[1] * intensity, texel[2] * intensity, 255);
+        return true;
+    }
+};
+
+// rasterizes triangle ids first and shades each visible pixel once afterwards
+static void render_deferred(const Model &model, int level, const std::vector<int> &faces,
+    const std::vector<ScreenVertex> &verts, const Camera &camera, TGAImage &image, ZBuffer &zbuffer,
+    const RenderOptions &options)
+{
+    VisibilityBuffer vbuffer(image.get_width(), image.get_height());
+    Rasterizer rasterizer(vbuffer, zbuffer, options.nthreads);
+    TextureShader shader;
+    shader.lightDir = camera.light;
+    shader.normals.resize(model.lod_nfaces(level));
+    if (options.texture && model.nuvs())
+    {
+        shader.texture = options.texture;
+        shader.uvs.resize(3 * shader.normals.size());
+        shader.levels.resize(shader.normals.size());
+    }
+
+    for (size_t k = 0; k < faces.size(); k++)
+    {
+        int i = faces[k];
+        const ScreenVertex *corners[3]; // coordinates scaled to screen dimensions
+        shader.normals[i] = face_corners(model, level, i, verts, corners);
+        if (shader.normals[i] * camera.light > 0)
+        {
+            draw_triangle(rasterizer, vbuffer, *corners[0], *corners[1], *corners[2], (unsigned int)i);
+            if (shader.texture)
+            {
+                Vec3i face = model.lod_face(level, i);
+                Vec2f *uv = &shader.uvs[3 * (size_t)i];
+                for (int j = 0; j < 3; j++)
+                {
+                    uv[j] = model.uv(model.lod_vertex(level, face[j]));
+                }
+                Vec3f e1 = corners[1]->screen - corners[0]->screen;
+                Vec3f e2 = corners[2]->screen - corners[0]->screen;
+                shader.levels[i] = shader.texture->level_of(uv, 0.5f * std::fabs(e1.x * e2.y - e1.y * e2.x));
+            }
+        }
+    }
+    rasterizer.flush();
+    rasterizer.shade(shader, image);
+}
+
+void render(const Model &model, const Camera &camera, TGAImage &image, ZBuffer &zbuffer,
+    const RenderOptions &options)
+{
+    int width = image.get_width();
+    int height = image.get_height();
+
+    // every vertex is transformed once, faces only look their corners up;
+    // a level of detail only transforms the vertices it uses
+    std::vector<ScreenVertex> verts;
+    if (options.mode == RENDER_WIREFRAME)
+    {
+        transform_vertices(model, camera.transform, width, height, verts);
+        draw_wireframe(model, verts, image, TGAColor(255, 255, 255, 255));
+        return;
+    }
+
+    int level = select_lod(model, camera.transform, options.lod_error);
+    transform_vertices(model, level, camera.transform, width, height, verts);
+    std::vector<int> faces = candidate_faces(model, level, camera, width, height);
+    if (options.mode == RENDER_DEFERRED)
+    {
+        render_deferred(model, level, faces, verts, camera, image, zbuffer, options);
+        return;
+    }
+
+    Rasterizer rasterizer(image, zbuffer, options.nthreads);
+    for (size_t k = 0; k < faces.size(); k++)
+    {
+        int i = faces[k];
+        const ScreenVertex *corners[3]; // coordinates scaled to screen dimensions
+        Vec3f n = face_corners(model, level, i, verts, corners);
+
+        // intensity is the dot product of the light direction and normal vector of faces
+        float intensity = n * camera.light;
+
+        if (intensity > 0)
+        {
+            draw_triangle(rasterizer, *corners[0], *corners[1], *corners[2],
+                TGAColor(intensity * 255, intensity * 255, intensity * 255, 255));
+        }
+    }
+    rasterizer.flush();
+}
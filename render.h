@@ -0,0 +1,50 @@
+/**
+ * Header file for rendering whole frames of a model.
+ */
+
+#ifndef __RENDER_H__
+#define __RENDER_H__
+
+#include "geometry.h"
+#include "tgaimage.h"
+#include "zbuffer.h"
+#include "model.h"
+#include "texture.h"
+
+// how many pixels a level of detail may be off by on screen by default
+const float LOD_PIXEL_ERROR = 1;
+
+// how the faces of a frame are drawn
+enum RenderMode
+{
+    RENDER_FORWARD,    // each face is shaded as it is rasterized
+    RENDER_DEFERRED,   // visible faces are found first, each pixel is shaded once
+    RENDER_WIREFRAME   // only the edges of the full model
+};
+
+// where a frame is looked at the model from
+struct Camera
+{
+    Matrix transform;  // from model space to pixels, viewport * projection * modelview
+    Vec3f light;       // the direction the light is coming from, in model space
+};
+
+struct RenderOptions
+{
+    RenderMode mode;
+    float lod_error;         // see select_lod(), only matters if the model has levels of detail
+    const Texture *texture;  // mapped onto the model in deferred mode, NULL for white
+    int nthreads;            // rasterizer threads, 0 for the shared default_thread_pool()
+
+    RenderOptions() : mode(RENDER_FORWARD), lod_error(LOD_PIXEL_ERROR), texture(NULL), nthreads(0) {}
+};
+
+// draws one frame of the model over what image and zbuffer (of the same
+// size) already hold; the model is only read and nothing outside the
+// arguments is touched, so any number of threads can render frames of the
+// same model at once, each into its own image and zbuffer; jobs running on
+// default_thread_pool() have to render with nthreads 1
+void render(const Model &model, const Camera &camera, TGAImage &image, ZBuffer &zbuffer,
+    const RenderOptions &options = RenderOptions());
+
+#endif //__RENDER_H__
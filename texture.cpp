@@ -0,0 +1,190 @@
+/**
+ * Textures: the mip chain of an image in a tiled layout, and the filters
+ * that sample it.
+ */
+
+#include <cmath>
+#include <string.h>
+#include <algorithm>
+#include "texture.h"
+
+// the bits of a coordinate within a tile, spread out to every other bit
+static const uint32_t MORTON_SPREAD[TEXTURE_TILE] = {0, 1, 4, 5, 16, 17, 20, 21};
+
+// blends two texels by t / 256, all four channels at once, two of them in
+// each half of a word
+static uint32_t lerp_texel(uint32_t a, uint32_t b, uint32_t t)
+{
+    uint32_t rb = (((a & 0x00ff00ff) * (256 - t) + (b & 0x00ff00ff) * t) >> 8) & 0x00ff00ff;
+    uint32_t ga = ((((a >> 8) & 0x00ff00ff) * (256 - t) + ((b >> 8) & 0x00ff00ff) * t) >> 8) & 0x00ff00ff;
+    return rb | (ga << 8);
+}
+
+// the rounded average of four texels, the same way
+static uint32_t average_texels(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+    uint32_t rb = (a & 0x00ff00ff) + (b & 0x00ff00ff) + (c & 0x00ff00ff) + (d & 0x00ff00ff);
+    uint32_t ga = ((a >> 8) & 0x00ff00ff) + ((b >> 8) & 0x00ff00ff) + ((c >> 8) & 0x00ff00ff) +
+        ((d >> 8) & 0x00ff00ff);
+    return (((rb + 0x00020002) >> 2) & 0x00ff00ff) | ((((ga + 0x00020002) >> 2) & 0x00ff00ff) << 8);
+}
+
+// wraps a coordinate into [0, 1)
+static float wrap(float t)
+{
+    t -= std::floor(t);
+    return t < 1 ? t : 0;
+}
+
+Texture::Texture(TGAImage &image) : bytespp_(image.get_bytespp()), texels_(), levels_()
+{
+    // lays the levels out one after the other, each padded to whole tiles
+    int w = std::max(1, image.get_width());
+    int h = std::max(1, image.get_height());
+    size_t size = 0;
+    for (;;)
+    {
+        TextureLevel level;
+        level.width = w;
+        level.height = h;
+        level.tilesx = (w + TEXTURE_TILE - 1) / TEXTURE_TILE;
+        level.offset = size;
+        size += (size_t)level.tilesx * ((h + TEXTURE_TILE - 1) / TEXTURE_TILE) * TEXTURE_TILE * TEXTURE_TILE;
+        levels_.push_back(level);
+        if (w == 1 && h == 1)
+        {
+            break;
+        }
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
+    }
+    texels_.assign(size, 0);
+
+    const unsigned char *data = image.buffer();
+    if (data)
+    {
+        const TextureLevel &top = levels_[0];
+        for (int y = 0; y < top.height; y++)
+        {
+            for (int x = 0; x < top.width; x++)
+            {
+                uint32_t texel = 0;
+                memcpy(&texel, data + ((size_t)y * top.width + x) * bytespp_, bytespp_);
+                texels_[address(top, x, y)] = texel;
+            }
+        }
+    }
+
+    // odd sizes repeat the last row or column of the level above
+    for (size_t i = 1; i < levels_.size(); i++)
+    {
+        const TextureLevel &src = levels_[i - 1];
+        const TextureLevel &dst = levels_[i];
+        for (int y = 0; y < dst.height; y++)
+        {
+            int y0 = std::min(2 * y, src.height - 1);
+            int y1 = std::min(2 * y + 1, src.height - 1);
+            for (int x = 0; x < dst.width; x++)
+            {
+                int x0 = std::min(2 * x, src.width - 1);
+                int x1 = std::min(2 * x + 1, src.width - 1);
+                texels_[address(dst, x, y)] = average_texels(texels_[address(src, x0, y0)],
+                    texels_[address(src, x1, y0)], texels_[address(src, x0, y1)], texels_[address(src, x1, y1)]);
+            }
+        }
+    }
+}
+
+// where texel (x, y) of a level is in the texel buffer
+size_t Texture::address(const TextureLevel &level, int x, int y) const
+{
+    size_t tile = (size_t)(y >> TEXTURE_TILE_BITS) * level.tilesx + (x >> TEXTURE_TILE_BITS);
+    return level.offset + (tile << (2 * TEXTURE_TILE_BITS)) + MORTON_SPREAD[x & (TEXTURE_TILE - 1)] +
+        (MORTON_SPREAD[y & (TEXTURE_TILE - 1)] << 1);
+}
+
+TGAColor Texture::color(uint32_t texel) const
+{
+    unsigned char bytes[4];
+    memcpy(bytes, &texel, 4);
+    return TGAColor(bytes, bytespp_);
+}
+
+int Texture::get_width() const
+{
+    return levels_[0].width;
+}
+
+int Texture::get_height() const
+{
+    return levels_[0].height;
+}
+
+int Texture::get_bytespp() const
+{
+    return bytespp_;
+}
+
+int Texture::nlevels() const
+{
+    return (int)levels_.size();
+}
+
+float Texture::level_of(const Vec2f *uv, float area) const
+{
+    Vec2f a = uv[1] - uv[0];
+    Vec2f b = uv[2] - uv[0];
+    float texels = std::fabs(a.x * b.y - a.y * b.x) * levels_[0].width * levels_[0].height;
+    float level = 0.5f * std::log2(texels / area);
+    return level > 0 ? level : 0;
+}
+
+TGAColor Texture::nearest(Vec2f uv, int level) const
+{
+    const TextureLevel &l = levels_[std::max(0, std::min(level, nlevels() - 1))];
+    int x = std::min((int)(wrap(uv.x) * l.width), l.width - 1);
+    int y = std::min((int)(wrap(uv.y) * l.height), l.height - 1);
+    return color(texels_[address(l, x, y)]);
+}
+
+// the bilinear sample of a level as a texel; the texel centers are at half
+// integers, and neighbours past the edge wrap around
+uint32_t Texture::bilinear_texel(int level, Vec2f uv) const
+{
+    const TextureLevel &l = levels_[level];
+    float fx = wrap(uv.x) * l.width - 0.5f;
+    float fy = wrap(uv.y) * l.height - 0.5f;
+    int x0 = (int)std::floor(fx);
+    int y0 = (int)std::floor(fy);
+    uint32_t tx = (uint32_t)((fx - x0) * 256);
+    uint32_t ty = (uint32_t)((fy - y0) * 256);
+    int x1 = x0 + 1 < l.width ? x0 + 1 : 0;
+    int y1 = y0 + 1 < l.height ? y0 + 1 : 0;
+    x0 = x0 < 0 ? l.width - 1 : x0;
+    y0 = y0 < 0 ? l.height - 1 : y0;
+
+    uint32_t top = lerp_texel(texels_[address(l, x0, y0)], texels_[address(l, x1, y0)], tx);
+    uint32_t bottom = lerp_texel(texels_[address(l, x0, y1)], texels_[address(l, x1, y1)], tx);
+    return lerp_texel(top, bottom, ty);
+}
+
+TGAColor Texture::bilinear(Vec2f uv, int level) const
+{
+    return color(bilinear_texel(std::max(0, std::min(level, nlevels() - 1)), uv));
+}
+
+TGAColor Texture::trilinear(Vec2f uv, float level) const
+{
+    if (!(level > 0))
+    {
+        return color(bilinear_texel(0, uv));
+    }
+    int last = nlevels() - 1;
+    if (level >= last)
+    {
+        return color(bilinear_texel(last, uv));
+    }
+    int l0 = (int)level;
+    uint32_t t = (uint32_t)((level - l0) * 256);
+    return color(lerp_texel(bilinear_texel(l0, uv), bilinear_texel(l0 + 1, uv), t));
+}
@@ -0,0 +1,65 @@
+/**
+ * Header file for textures: images prepared for sampling, with a chain of
+ * mip levels stored tile by tile.
+ */
+
+#ifndef __TEXTURE_H__
+#define __TEXTURE_H__
+
+#include <vector>
+#include <stdint.h>
+#include "geometry.h"
+#include "tgaimage.h"
+
+// levels are stored in square tiles of 1 << TEXTURE_TILE_BITS texels on a
+// side (256 bytes for 8), with the texels of a tile in Morton order, so
+// texels that are close in the image are close in memory in both directions
+const int TEXTURE_TILE_BITS = 3;
+const int TEXTURE_TILE = 1 << TEXTURE_TILE_BITS;
+
+// one level of the mip chain
+struct TextureLevel
+{
+    int width;
+    int height;
+    int tilesx;     // tiles per row of tiles
+    size_t offset;  // index of its first texel in the texel buffer
+};
+
+// an image sampled with repeating texture coordinates, (0, 0) being the
+// first texel of the image buffer and (1, 1) the far corner of the last
+class Texture
+{
+private:
+    int bytespp_;
+    std::vector<uint32_t> texels_;  // 4 bytes per texel, in the image's byte order
+    std::vector<TextureLevel> levels_;
+
+    size_t address(const TextureLevel &level, int x, int y) const;
+    TGAColor color(uint32_t texel) const;
+    uint32_t bilinear_texel(int level, Vec2f uv) const;
+public:
+    // copies the image into level 0, and builds every smaller level down to
+    // 1 x 1 by averaging 2 x 2 texels of the one above
+    Texture(TGAImage &image);
+    int get_width() const;
+    int get_height() const;
+    int get_bytespp() const;
+    int nlevels() const;
+
+    // the mip level at which one texel covers about one pixel, for a
+    // triangle with the texture coordinates uv that covers area pixels
+    float level_of(const Vec2f *uv, float area) const;
+
+    // the texel of a level closest to uv
+    TGAColor nearest(Vec2f uv, int level = 0) const;
+
+    // the 4 texels of a level around uv, weighted by their distance
+    TGAColor bilinear(Vec2f uv, int level = 0) const;
+
+    // bilinear samples of the two levels around level, blended by its
+    // fraction; levels outside the chain are clamped to it
+    TGAColor trilinear(Vec2f uv, float level) const;
+};
+
+#endif //__TEXTURE_H__
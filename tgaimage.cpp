@@ -1,103 +1,239 @@
 #include <iostream>
 #include <fstream>
 #include <string.h>
+#include <stdlib.h>
 #include <time.h>
 #include <math.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "tgaimage.h"
 
-TGAImage::TGAImage() : data(NULL), width(0), height(0), bytespp(0) {}
+// takes buffers from the heap, rounded up to whole aligned blocks
+struct HeapAllocator : public TGAAllocator 
+{
+	unsigned char *allocate(unsigned long nbytes) 
+    {
+		unsigned long size = (std::max(nbytes, 1ul) + TGA_ALIGNMENT - 1) / TGA_ALIGNMENT * TGA_ALIGNMENT;
+		return (unsigned char *)aligned_alloc(TGA_ALIGNMENT, size);
+	}
+
+	void deallocate(unsigned char *p, unsigned long /*nbytes*/) 
+    {
+		free(p);
+	}
+};
+
+TGAAllocator *tga_default_allocator() 
+{
+	static HeapAllocator heap;
+	return &heap;
+}
+
+TGAPool::TGAPool() : mutex_(), free_() {}
+
+// destructor, hands every kept buffer back to the heap
+TGAPool::~TGAPool() 
+{
+	for (std::multimap<unsigned long, unsigned char *>::iterator i = free_.begin(); i != free_.end(); ++i) 
+    {
+		tga_default_allocator()->deallocate(i->second, i->first);
+	}
+}
+
+unsigned char *TGAPool::allocate(unsigned long nbytes) 
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::multimap<unsigned long, unsigned char *>::iterator i = free_.find(nbytes);
+		if (i != free_.end()) 
+        {
+			unsigned char *p = i->second;
+			free_.erase(i);
+			return p;
+		}
+	}
+	return tga_default_allocator()->allocate(nbytes);
+}
+
+void TGAPool::deallocate(unsigned char *p, unsigned long nbytes) 
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	free_.insert(std::make_pair(nbytes, p));
+}
+
+TGAImage::TGAImage() : data(NULL), width(0), height(0), bytespp(0), allocator(tga_default_allocator()) {}
+
+TGAImage::TGAImage(TGAAllocator *alloc) : data(NULL), width(0), height(0), bytespp(0), 
+    allocator(alloc ? alloc : tga_default_allocator()) {}
 
-TGAImage::TGAImage(int w, int h, int bpp) : data(NULL), width(w), height(h), bytespp(bpp) 
+TGAImage::TGAImage(int w, int h, int bpp, TGAAllocator *alloc) : data(NULL), width(w), height(h), bytespp(bpp), 
+    allocator(alloc ? alloc : tga_default_allocator())
 {
-	unsigned long nbytes = width * height * bytespp;
-	data = new unsigned char[nbytes];
-	memset(data, 0, nbytes);
+	allocate();
+	memset(data, 0, (unsigned long)width * height * bytespp);
 }
 
 TGAImage::TGAImage(const TGAImage &img) : data(NULL), width(img.width), height(img.height), 
-    bytespp(img.bytespp) 
+    bytespp(img.bytespp), allocator(img.allocator)
 {
-	unsigned long nbytes = width * height * bytespp;
-	data = new unsigned char[nbytes];
-	memcpy(data, img.data, nbytes);
+	allocate();
+	if (img.data) 
+    {
+		memcpy(data, img.data, (unsigned long)width * height * bytespp);
+	}
+}
+
+// takes over the buffer of img, which is left empty
+TGAImage::TGAImage(TGAImage &&img) : data(img.data), width(img.width), height(img.height), 
+    bytespp(img.bytespp), allocator(img.allocator)
+{
+	img.data = NULL;
+	img.width = img.height = img.bytespp = 0;
 }
 
 TGAImage::~TGAImage() 
 {
-	if (data) delete [] data;
+	release();
 }
 
 TGAImage & TGAImage::operator =(const TGAImage &img) 
 {
 	if (this != &img) 
     {
-		if (data) delete [] data;
+		release();
 		width  = img.width;
 		height = img.height;
 		bytespp = img.bytespp;
-		unsigned long nbytes = width*height*bytespp;
-		data = new unsigned char[nbytes];
-		memcpy(data, img.data, nbytes);
+		allocator = img.allocator;
+		allocate();
+		if (img.data) 
+        {
+			memcpy(data, img.data, (unsigned long)width * height * bytespp);
+		}
 	}
 	return *this;
 }
 
-bool TGAImage::read_tga_file(const char *filename) 
+TGAImage & TGAImage::operator =(TGAImage &&img) 
 {
-	if (data) delete [] data;
+	if (this != &img) 
+    {
+		release();
+		data = img.data;
+		width  = img.width;
+		height = img.height;
+		bytespp = img.bytespp;
+		allocator = img.allocator;
+		img.data = NULL;
+		img.width = img.height = img.bytespp = 0;
+	}
+	return *this;
+}
+
+// gets a buffer for the current size from the allocator
+void TGAImage::allocate() 
+{
+	data = allocator->allocate((unsigned long)width * height * bytespp);
+}
+
+// gives the buffer back, the size must still be the one it was allocated for
+void TGAImage::release() 
+{
+	if (data) 
+    {
+		allocator->deallocate(data, (unsigned long)width * height * bytespp);
+	}
 	data = NULL;
-	std::ifstream in;
-	in.open (filename, std::ios::binary);
-	if (!in.is_open()) 
+}
+
+// maps the whole file and decodes it from memory
+bool TGAImage::read_tga_file(const char *filename) 
+{
+	release();
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) 
     {
 		std::cerr << "can't open file " << filename << "\n";
-		in.close();
 		return false;
 	}
+	struct stat st;
+	void *file = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) 
+    {
+		file = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (file == MAP_FAILED) 
+    {
+		std::cerr << "can't map file " << filename << "\n";
+		return false;
+	}
+	madvise(file, st.st_size, MADV_SEQUENTIAL);
+	bool ok = decode(file, st.st_size);
+	munmap(file, st.st_size);
+	if (ok) 
+    {
+		std::cerr << width << "x" << height << "/" << bytespp * 8 << "\n";
+	}
+	return ok;
+}
 
+// decodes a whole tga file of size bytes; every read is checked against
+// the end of the file and every write against the size the header gives
+bool TGAImage::decode(const void *file, unsigned long size) 
+{
 	TGA_Header header;
-	in.read((char *)&header, sizeof(header));
-	if (!in.good()) 
+	if (size < sizeof(header)) 
     {
-		in.close();
 		std::cerr << "an error occured while reading the header\n";
 		return false;
 	}
+	memcpy(&header, file, sizeof(header));
 
 	width   = header.width;
 	height  = header.height;
 	bytespp = header.bitsperpixel >> 3;
 	if (width <= 0 || height <= 0 || (bytespp != GRAYSCALE && bytespp != RGB && bytespp != RGBA)) 
     {
-		in.close();
 		std::cerr << "bad bpp (or width/height) value\n";
 		return false;
 	}
 
-	unsigned long nbytes = bytespp * width * height;
-	data = new unsigned char[nbytes];
+	// the pixels follow the image id and the color map, if any
+	unsigned long skip = sizeof(header) + (unsigned char)header.idlength;
+	if (header.colormaptype) 
+    {
+		skip += (unsigned long)(unsigned short)header.colormaplength * (((unsigned char)header.colormapdepth + 7) >> 3);
+	}
+	const unsigned char *in = (const unsigned char *)file + std::min(skip, size);
+	unsigned long avail = size - std::min(skip, size);
+
+	unsigned long nbytes = (unsigned long)bytespp * width * height;
+	allocate();
 	if (3 == header.datatypecode || 2 == header.datatypecode) 
     {
-		in.read((char *)data, nbytes);
-		if (!in.good()) 
+		if (avail < nbytes) 
         {
-			in.close();
 			std::cerr << "an error occured while reading the data\n";
 			return false;
 		}
+		memcpy(data, in, nbytes);
 	} 
     else if (10==header.datatypecode||11==header.datatypecode) 
     {
-		if (!load_rle_data(in)) 
+		if (!decode_rle_data(in, avail)) 
         {
-			in.close();
 			std::cerr << "an error occured while reading the data\n";
 			return false;
 		}
 	} 
     else 
     {
-		in.close();
 		std::cerr << "unknown file format " << (int)header.datatypecode << "\n";
 		return false;
 	}
@@ -110,80 +246,46 @@ bool TGAImage::read_tga_file(const char *filename)
     {
 		flip_horizontally();
 	}
-	std::cerr << width << "x" << height << "/" << bytespp * 8 << "\n";
-	in.close();
 	return true;
 }
 
-bool TGAImage::load_rle_data(std::ifstream &in) 
+// decodes rle chunks from size bytes at in until the image is full; raw
+// chunks are copied at once and runs filled by doubling the copied part
+bool TGAImage::decode_rle_data(const unsigned char *in, unsigned long size) 
 {
-	unsigned long pixelCount = width * height;
-	unsigned long currentPixel = 0;
-	unsigned long currentByte  = 0;
-	TGAColor colorBuffer;
-
-	do 
+	unsigned long nbytes = (unsigned long)width * height * bytespp;
+	const unsigned char *end = in + size;
+	unsigned char *out = data;
+	unsigned char *full = data + nbytes;
+	while (out < full) 
     {
-		unsigned char chunkHeader = 0;
-		chunkHeader = in.get();
-		if (!in.good()) 
+		if (in == end) 
         {
 			std::cerr << "an error occured while reading the data\n";
 			return false;
 		}
+		unsigned char chunkHeader = *in++;
+		unsigned long count = ((chunkHeader & 127) + 1) * (unsigned long)bytespp;
+		if (count > (unsigned long)(full - out)) 
+        {
+			std::cerr << "Too many pixels read\n";
+			return false;
+		}
 
-		if (chunkHeader < 128) 
+		unsigned long packet = chunkHeader < 128 ? count : bytespp;
+		if (packet > (unsigned long)(end - in)) 
         {
-			chunkHeader++;
-			for (int i = 0; i < chunkHeader; i++) 
-            {
-				in.read((char *)colorBuffer.rgba, bytespp);
-				if (!in.good()) 
-                {
-					std::cerr << "an error occured while reading the header\n";
-					return false;
-				}
-
-				for (int t = 0; t < bytespp; t++)
-                {
-					data[currentByte++] = colorBuffer.rgba[t];
-                }
-				currentPixel++;
-
-				if (currentPixel > pixelCount) 
-                {
-					std::cerr << "Too many pixels read\n";
-					return false;
-				}
-			}
-		} 
-        else 
+			std::cerr << "an error occured while reading the data\n";
+			return false;
+		}
+		memcpy(out, in, packet);
+		in += packet;
+		for (unsigned long filled = packet; filled < count; filled *= 2) 
         {
-			chunkHeader -= 127;
-			in.read((char *)colorBuffer.rgba, bytespp);
-			if (!in.good()) 
-            {
-				std::cerr << "an error occured while reading the header\n";
-				return false;
-			}
-
-			for (int i = 0; i < chunkHeader; i++) 
-            {
-				for (int t = 0; t < bytespp; t++)
-                {
-					data[currentByte++] = colorBuffer.rgba[t];
-                }
-				currentPixel++;
-
-				if (currentPixel>pixelCount) 
-                {
-					std::cerr << "Too many pixels read\n";
-					return false;
-				}
-			}
+			memcpy(out + filled, out, std::min(filled, count - filled));
 		}
-	} 
-    while (currentPixel < pixelCount);
+		out += count;
+	}
 	return true;
 }
 
@@ -208,113 +310,125 @@ bool TGAImage::write_tga_file(const char *filename, bool rle)
 	header.height = height;
 	header.datatypecode = (bytespp == GRAYSCALE ? (rle ? 11 : 3) : (rle ? 10 : 2));
 	header.imagedescriptor = 0x20; // top-left origin
-	out.write((char *)&header, sizeof(header));
-	if (!out.good()) 
-    {
-		out.close();
-		std::cerr << "can't dump the tga file\n";
-		return false;
-	}
 
+	// the whole file is put together in memory and written at once; rle
+	// data takes at most one header byte per chunk more than raw data
+	unsigned long nbytes = (unsigned long)width * height * bytespp;
+	unsigned long maxdata = nbytes + (rle ? ((unsigned long)width * height + 127) / 128 : 0);
+	std::vector<unsigned char> file(sizeof(header) + maxdata + sizeof(developer_area_ref) + 
+		sizeof(extension_area_ref) + sizeof(footer));
+	unsigned char *p = file.data();
+	memcpy(p, &header, sizeof(header));
+	p += sizeof(header);
 	if (!rle) 
     {
-		out.write((char *)data, width*height*bytespp);
-		if (!out.good()) 
-        {
-			std::cerr << "can't unload raw data\n";
-			out.close();
-			return false;
-		}
+		memcpy(p, data, nbytes);
+		p += nbytes;
 	} 
     else 
     {
-		if (!unload_rle_data(out)) 
-        {
-			out.close();
-			std::cerr << "can't unload rle data\n";
-			return false;
-		}
+		p += encode_rle_data(p);
 	}
-
-	out.write((char *)developer_area_ref, sizeof(developer_area_ref));
+	memcpy(p, developer_area_ref, sizeof(developer_area_ref));
+	p += sizeof(developer_area_ref);
+	memcpy(p, extension_area_ref, sizeof(extension_area_ref));
+	p += sizeof(extension_area_ref);
+	memcpy(p, footer, sizeof(footer));
+	p += sizeof(footer);
+
+	out.write((char *)file.data(), p - file.data());
 	if (!out.good()) 
     {
 		std::cerr << "can't dump the tga file\n";
 		out.close();
 		return false;
 	}
+	out.close();
+	return true;
+}
 
-	out.write((char *)extension_area_ref, sizeof(extension_area_ref));
-	if (!out.good()) 
+// the most pixels an rle chunk can hold
+const unsigned long MAX_CHUNK_LENGTH = 128;
+
+// the number of leading bytes a and b have in common, at most n; compared
+// eight bytes at a time until they differ
+static unsigned long common_prefix(const unsigned char *a, const unsigned char *b, unsigned long n)
+{
+	unsigned long i = 0;
+	for (; i + 8 <= n; i += 8) 
     {
-		std::cerr << "can't dump the tga file\n";
-		out.close();
-		return false;
+		uint64_t x, y;
+		memcpy(&x, a + i, 8);
+		memcpy(&y, b + i, 8);
+		if (x != y) 
+        {
+			break;
+		}
 	}
-
-	out.write((char *)footer, sizeof(footer));
-	if (!out.good()) 
+	while (i < n && a[i] == b[i]) 
     {
-		std::cerr << "can't dump the tga file\n";
-		out.close();
+		i++;
+	}
+	return i;
+}
+
+// the length of the run of equal pixels that starts at pixel i of an image
+// of npixels, at most limit
+static unsigned long run_length(const unsigned char *data, int bytespp, unsigned long npixels, unsigned long i, 
+	unsigned long limit)
+{
+	unsigned long n = std::min(npixels, i + limit) - i - 1;
+	return 1 + common_prefix(data + i * bytespp, data + (i + 1) * bytespp, n * bytespp) / bytespp;
+}
+
+// whether the run at pixel i is better off as a chunk of its own than as
+// part of the raw chunk before it; that costs a chunk header and a pixel,
+// plus another header to go on with raw pixels unless a run follows
+static bool worth_run(const unsigned char *data, int bytespp, unsigned long npixels, unsigned long i)
+{
+	unsigned long run = run_length(data, bytespp, npixels, i, MAX_CHUNK_LENGTH);
+	if (run < 2)
+	{
 		return false;
 	}
-	out.close();
-	return true;
+	unsigned long next = i + run;
+	bool restart = next < npixels && run_length(data, bytespp, npixels, next, 2) < 2;
+	return run * bytespp > (unsigned long)(1 + bytespp + restart);
 }
 
-// TODO: it is not necessary to break a raw chunk for two equal pixels (for the matter of the resulting size)
-bool TGAImage::unload_rle_data(std::ofstream &out) 
+// encodes the pixels as rle chunks into out, returns the number of bytes
+// written; a run inside raw pixels only gets a chunk of its own if that
+// makes the file smaller, counting the header that restarts the raw chunk
+unsigned long TGAImage::encode_rle_data(unsigned char *out) 
 {
-	const unsigned char max_chunk_length = 128;
-	unsigned long npixels = width * height;
-	unsigned long curpix = 0;
+	unsigned long npixels = (unsigned long)width * height;
+	unsigned char *start = out;
 
+	unsigned long curpix = 0;
 	while (curpix < npixels) 
     {
-		unsigned long chunkstart = curpix * bytespp;
-		unsigned long curbyte = curpix * bytespp;
-		unsigned char run_length = 1;
-		bool raw = true;
-		while (curpix + run_length < npixels && run_length < max_chunk_length) 
-        {
-			bool succ_eq = true;
-			for (int t = 0; succ_eq && t < bytespp; t++) 
-            {
-				succ_eq = (data[curbyte + t] == data[curbyte + t + bytespp]);
-			}
-			curbyte += bytespp;
-
-			if (1 == run_length) 
-            {
-				raw = !succ_eq;
-			}
-			if (raw && succ_eq) 
-            {
-				run_length--;
-				break;
-			}
-			if (!raw && !succ_eq) 
-            {
-				break;
-			}
-			run_length++;
-		}
-		curpix += run_length;
-		out.put(raw ? run_length - 1 : run_length + 127);
-		if (!out.good()) 
+		unsigned long run = run_length(data, bytespp, npixels, curpix, MAX_CHUNK_LENGTH);
+		if (run >= 2) 
         {
-			std::cerr << "can't dump the tga file\n";
-			return false;
+			*out++ = (unsigned char)(run + 127);
+			memcpy(out, data + curpix * bytespp, bytespp);
+			out += bytespp;
+			curpix += run;
+			continue;
 		}
-		out.write((char *)(data + chunkstart), (raw ? run_length * bytespp : bytespp));
-		if (!out.good()) 
+
+		// raw pixels up to the next run worth its own chunk
+		unsigned long end = curpix + 1;
+		while (end < npixels && end - curpix < MAX_CHUNK_LENGTH && !worth_run(data, bytespp, npixels, end)) 
         {
-			std::cerr << "can't dump the tga file\n";
-			return false;
+			end++;
 		}
+		*out++ = (unsigned char)(end - curpix - 1);
+		memcpy(out, data + curpix * bytespp, (end - curpix) * bytespp);
+		out += (end - curpix) * bytespp;
+		curpix = end;
 	}
-	return true;
+	return out - start;
 }
 
 TGAColor TGAImage::get(int x, int y) 
@@ -409,7 +523,7 @@ void TGAImage::clear()
 bool TGAImage::scale(int w, int h) 
 {
 	if (w <= 0 || h <= 0 || !data) return false;
-	unsigned char *tdata = new unsigned char[w * h * bytespp];
+	unsigned char *tdata = allocator->allocate((unsigned long)w * h * bytespp);
 	int nscanline = 0;
 	int oscanline = 0;
 	int erry = 0;
@@ -442,7 +556,7 @@ bool TGAImage::scale(int w, int h)
 		}
 	}
 
-	delete [] data;
+	release();
 	data = tdata;
 	width = w;
 	height = h;
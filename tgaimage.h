@@ -2,6 +2,8 @@
 #define __IMAGE_H__
 
 #include <fstream>
+#include <map>
+#include <mutex>
 
 #pragma pack(push,1)
 struct TGA_Header 
@@ -82,6 +84,37 @@ struct TGAColor
 };
 
 
+// pixel buffers start at a multiple of this many bytes, so whole cache
+// lines and the widest vector stores line up with them
+const unsigned long TGA_ALIGNMENT = 64;
+
+// where images get their pixel buffers from; allocate must return
+// TGA_ALIGNMENT aligned memory, and deallocate gets the same size back
+struct TGAAllocator 
+{
+	virtual ~TGAAllocator() {}
+	virtual unsigned char *allocate(unsigned long nbytes) = 0;
+	virtual void deallocate(unsigned char *p, unsigned long nbytes) = 0;
+};
+
+// the allocator of images that are not given one, straight from the heap
+TGAAllocator *tga_default_allocator();
+
+// keeps the buffers of destroyed images for the next image of the same
+// size, so a sequence of frames stops allocating after the first ones; it
+// may be shared between threads and has to outlive the images using it
+class TGAPool : public TGAAllocator 
+{
+private:
+	std::mutex mutex_;
+	std::multimap<unsigned long, unsigned char *> free_;
+public:
+	TGAPool();
+	~TGAPool();
+	unsigned char *allocate(unsigned long nbytes);
+	void deallocate(unsigned char *p, unsigned long nbytes);
+};
+
 class TGAImage 
 {
 protected:
@@ -89,9 +122,14 @@ protected:
 	int width;
 	int height;
 	int bytespp;
+	TGAAllocator *allocator;
+
+	void allocate();
+	void release();
 
-	bool load_rle_data(std::ifstream &in);
-	bool unload_rle_data(std::ofstream &out);
+	bool decode(const void *file, unsigned long size);
+	bool decode_rle_data(const unsigned char *in, unsigned long size);
+	unsigned long encode_rle_data(unsigned char *out);
 public:
 	enum Format 
     {
@@ -99,8 +137,10 @@ public:
 	};
 
 	TGAImage();
-	TGAImage(int w, int h, int bpp);
+	explicit TGAImage(TGAAllocator *alloc);
+	TGAImage(int w, int h, int bpp, TGAAllocator *alloc = NULL);
 	TGAImage(const TGAImage &img);
+	TGAImage(TGAImage &&img);
 	bool read_tga_file(const char *filename);
 	bool write_tga_file(const char *filename, bool rle=true);
 	bool flip_horizontally();
@@ -111,6 +151,7 @@ public:
     bool set(int x, int y, const TGAColor &c);
 	~TGAImage();
 	TGAImage & operator =(const TGAImage &img);
+	TGAImage & operator =(TGAImage &&img);
 	int get_width();
 	int get_height();
 	int get_bytespp();
@@ -0,0 +1,119 @@
+/**
+ * A fixed-size pool of worker threads that run indexed jobs.
+ */
+
+#include <algorithm>
+#include "threadpool.h"
+
+// starts nthreads - 1 workers, the calling thread makes up the last one
+// (nthreads <= 0 means one thread per core)
+ThreadPool::ThreadPool(int nthreads) : workers_(), job_(NULL), njobs_(0), next_(0), busy_(0),
+    generation_(0), stop_(false)
+{
+    if (nthreads <= 0)
+    {
+        nthreads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+
+    for (int i = 1; i < nthreads; i++)
+    {
+        workers_.push_back(std::thread(&ThreadPool::worker_loop, this));
+    }
+}
+
+// destructor
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+
+    for (size_t i = 0; i < workers_.size(); i++)
+    {
+        workers_[i].join();
+    }
+}
+
+// returns the number of threads that run jobs, including the caller
+int ThreadPool::size()
+{
+    return (int)workers_.size() + 1;
+}
+
+// calls fn(i) for every i in [0, n) spread over all threads and
+// returns once every call has finished
+void ThreadPool::parallel_for(int n, const std::function<void(int)> &fn)
+{
+    if (n <= 0)
+    {
+        return;
+    }
+
+    if (workers_.empty() || n == 1)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            fn(i);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit(submit_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &fn;
+        njobs_ = n;
+        next_ = 0;
+        busy_ = (int)workers_.size();
+        generation_++;
+    }
+    wake_.notify_all();
+
+    run_jobs();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return busy_ == 0; });
+    job_ = NULL;
+}
+
+// grabs job indices until there are none left
+void ThreadPool::run_jobs()
+{
+    for (int i = next_++; i < njobs_; i = next_++)
+    {
+        (*job_)(i);
+    }
+}
+
+void ThreadPool::worker_loop()
+{
+    unsigned long seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_)
+            {
+                return;
+            }
+            seen = generation_;
+        }
+
+        run_jobs();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--busy_ == 0)
+        {
+            done_.notify_one();
+        }
+    }
+}
+
+ThreadPool &default_thread_pool()
+{
+    static ThreadPool pool;
+    return pool;
+}
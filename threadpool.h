@@ -0,0 +1,43 @@
+/**
+ * Header file for a small pool of worker threads.
+ */
+
+#ifndef __THREADPOOL_H__
+#define __THREADPOOL_H__
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+class ThreadPool
+{
+private:
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::mutex submit_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(int)> *job_;
+    int njobs_;
+    std::atomic<int> next_;
+    int busy_;
+    unsigned long generation_;
+    bool stop_;
+    void worker_loop();
+    void run_jobs();
+public:
+    ThreadPool(int nthreads = 0);
+    ~ThreadPool();
+    int size();
+    void parallel_for(int n, const std::function<void(int)> &fn);
+};
+
+// the pool of one thread per core that the whole process shares, started
+// the first time it is asked for; its jobs must not call parallel_for() on
+// it again
+ThreadPool &default_thread_pool();
+
+#endif //__THREADPOOL_H__
@@ -0,0 +1,96 @@
+/**
+ * The visibility buffer: triangle ids per pixel, plus the second pass that
+ * turns them into colors.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include "vbuffer.h"
+
+VisibilityBuffer::VisibilityBuffer(int w, int h) : width_(w), height_(h), ids_(w * h, NO_TRIANGLE), 
+    edges_() {}
+
+// destructor
+VisibilityBuffer::~VisibilityBuffer() {}
+
+int VisibilityBuffer::get_width()
+{
+    return width_;
+}
+
+int VisibilityBuffer::get_height()
+{
+    return height_;
+}
+
+// returns the triangle ids, one row after another
+unsigned int *VisibilityBuffer::buffer()
+{
+    return ids_.data();
+}
+
+unsigned int VisibilityBuffer::get(int x, int y)
+{
+    return ids_[x + y * width_];
+}
+
+// marks every pixel as uncovered and forgets the triangles
+void VisibilityBuffer::clear()
+{
+    std::fill(ids_.begin(), ids_.end(), NO_TRIANGLE);
+    edges_.clear();
+}
+
+// the edge functions of 2D homogeneous rasterization: for a pixel p = (x, y, 1)
+// the three values edges[i] * p are proportional to the perspective correct
+// barycentric coordinates, even when some vertices are behind the camera
+void VisibilityBuffer::set_triangle(unsigned int id, Vec4f *clip)
+{
+    if (edges_.size() < 3 * (size_t)id + 3)
+    {
+        edges_.resize(3 * (size_t)id + 3);
+    }
+
+    Vec3f v[3];
+    for (int i = 0; i < 3; i++)
+    {
+        v[i] = Vec3f(clip[i][0], clip[i][1], clip[i][3]);
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        edges_[3 * id + i] = cross(v[(i + 1) % 3], v[(i + 2) % 3]);
+    }
+}
+
+// computes the barycentric coordinates of a pixel center
+static Vec3f barycentric(const Vec3f *edges, float x, float y)
+{
+    Vec3f p(x, y, 1.f);
+    Vec3f bar(edges[0] * p, edges[1] * p, edges[2] * p);
+    return bar / (bar.x + bar.y + bar.z);
+}
+
+void VisibilityBuffer::shade(IShader &shader, TGAImage &image, int y0, int y1)
+{
+    int bytespp = image.get_bytespp();
+    for (int y = y0; y <= y1; y++)
+    {
+        const unsigned int *row = &ids_[y * width_];
+        unsigned char *pixels = image.buffer() + y * width_ * bytespp;
+        for (int x = 0; x < width_; x++)
+        {
+            if (row[x] == NO_TRIANGLE)
+            {
+                continue;
+            }
+
+            // barycentric coordinates of the pixel center
+            Vec3f bar = barycentric(&edges_[3 * row[x]], x + .5f, y + .5f);
+            TGAColor color;
+            if (shader.fragment(row[x], bar, color))
+            {
+                memcpy(pixels + x * bytespp, color.rgba, bytespp);
+            }
+        }
+    }
+}
@@ -0,0 +1,50 @@
+/**
+ * Header file for the visibility buffer, which stores which triangle is
+ * visible at every pixel so that shading can happen in a second pass.
+ */
+
+#ifndef __VBUFFER_H__
+#define __VBUFFER_H__
+
+#include <vector>
+#include "geometry.h"
+#include "tgaimage.h"
+
+// the id of pixels that no triangle covers
+const unsigned int NO_TRIANGLE = 0xffffffff;
+
+// computes the color of a visible pixel from the id of its triangle and the
+// perspective correct barycentric coordinates of the pixel center in that
+// triangle, returns
+// false to leave the pixel untouched
+struct IShader
+{
+    virtual ~IShader() {}
+    virtual bool fragment(unsigned int id, Vec3f bar, TGAColor &color) = 0;
+};
+
+class VisibilityBuffer
+{
+private:
+    int width_;
+    int height_;
+    std::vector<unsigned int> ids_;
+    std::vector<Vec3f> edges_;  // homogeneous edge functions of every triangle by id
+public:
+    VisibilityBuffer(int w, int h);
+    ~VisibilityBuffer();
+    int get_width();
+    int get_height();
+    unsigned int *buffer();
+    unsigned int get(int x, int y);
+    void clear();
+
+    // records triangle id for shading, from its vertices in homogeneous
+    // screen coordinates (before the perspective divide)
+    void set_triangle(unsigned int id, Vec4f *clip);
+
+    // shades rows y0..y1 of the buffer into the image
+    void shade(IShader &shader, TGAImage &image, int y0, int y1);
+};
+
+#endif //__VBUFFER_H__
@@ -0,0 +1,97 @@
+/**
+ * A per-pixel depth buffer with a two level pyramid of depth ranges on top,
+ * used to throw away triangles and blocks that are hidden.
+ */
+
+#include <algorithm>
+#include <limits>
+#include "zbuffer.h"
+
+ZBuffer::ZBuffer(int w, int h) : width_(w), height_(h), depth_(), blockfar_(), blocknear_(), tilefar_()
+{
+    blocksx_ = (w + ZBLOCK_SIZE - 1) / ZBLOCK_SIZE;
+    blocksy_ = (h + ZBLOCK_SIZE - 1) / ZBLOCK_SIZE;
+    tilesx_ = (w + ZTILE_SIZE - 1) / ZTILE_SIZE;
+    int tilesy = (h + ZTILE_SIZE - 1) / ZTILE_SIZE;
+
+    depth_.resize(w * h);
+    blockfar_.resize(blocksx_ * blocksy_);
+    blocknear_.resize(blocksx_ * blocksy_);
+    tilefar_.resize(tilesx_ * tilesy);
+    clear();
+}
+
+// destructor
+ZBuffer::~ZBuffer() {}
+
+int ZBuffer::get_width()
+{
+    return width_;
+}
+
+int ZBuffer::get_height()
+{
+    return height_;
+}
+
+// returns the per-pixel depth values, one row after another
+float *ZBuffer::buffer()
+{
+    return depth_.data();
+}
+
+float ZBuffer::get(int x, int y)
+{
+    return depth_[x + y * width_];
+}
+
+// sets every depth to negative infinity
+void ZBuffer::clear()
+{
+    const float farthest = -std::numeric_limits<float>::max();
+    std::fill(depth_.begin(), depth_.end(), farthest);
+    std::fill(blockfar_.begin(), blockfar_.end(), farthest);
+    std::fill(blocknear_.begin(), blocknear_.end(), farthest);
+    std::fill(tilefar_.begin(), tilefar_.end(), farthest);
+}
+
+void ZBuffer::update_block(int bx, int by)
+{
+    int x0 = bx * ZBLOCK_SIZE;
+    int y0 = by * ZBLOCK_SIZE;
+    int x1 = std::min(x0 + ZBLOCK_SIZE, width_);
+    int y1 = std::min(y0 + ZBLOCK_SIZE, height_);
+
+    float zfar = std::numeric_limits<float>::max();
+    float znear = -std::numeric_limits<float>::max();
+    for (int y = y0; y < y1; y++)
+    {
+        const float *row = &depth_[y * width_];
+        for (int x = x0; x < x1; x++)
+        {
+            zfar = std::min(zfar, row[x]);
+            znear = std::max(znear, row[x]);
+        }
+    }
+    blockfar_[bx + by * blocksx_] = zfar;
+    blocknear_[bx + by * blocksx_] = znear;
+}
+
+void ZBuffer::update_tile(int tx, int ty)
+{
+    const int nblocks = ZTILE_SIZE / ZBLOCK_SIZE;
+    int bx0 = tx * nblocks;
+    int by0 = ty * nblocks;
+    int bx1 = std::min(bx0 + nblocks, blocksx_);
+    int by1 = std::min(by0 + nblocks, blocksy_);
+
+    float zfar = std::numeric_limits<float>::max();
+    for (int by = by0; by < by1; by++)
+    {
+        for (int bx = bx0; bx < bx1; bx++)
+        {
+            zfar = std::min(zfar, blockfar_[bx + by * blocksx_]);
+        }
+    }
+    tilefar_[tx + ty * tilesx_] = zfar;
+}
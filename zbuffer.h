@@ -0,0 +1,49 @@
+/**
+ * Header file for the depth buffer. Larger depth values are closer to the
+ * camera.
+ */
+
+#ifndef __ZBUFFER_H__
+#define __ZBUFFER_H__
+
+#include <vector>
+
+// the depth buffer keeps the depth range of every ZBLOCK_SIZE square block
+// of pixels, and of every ZTILE_SIZE square tile of blocks
+const int ZBLOCK_SIZE = 8;
+const int ZTILE_SIZE  = 64;
+
+class ZBuffer
+{
+private:
+    int width_;
+    int height_;
+    int blocksx_;
+    int blocksy_;
+    int tilesx_;
+    std::vector<float> depth_;
+    std::vector<float> blockfar_;   // farthest depth in each block
+    std::vector<float> blocknear_;  // closest depth in each block
+    std::vector<float> tilefar_;    // farthest depth in each tile
+public:
+    ZBuffer(int w, int h);
+    ~ZBuffer();
+    int get_width();
+    int get_height();
+    float *buffer();
+    float get(int x, int y);
+    void clear();
+
+    // depth range of block (bx, by), in block coordinates
+    float block_far(int bx, int by) { return blockfar_[bx + by * blocksx_]; }
+    float block_near(int bx, int by) { return blocknear_[bx + by * blocksx_]; }
+
+    // farthest depth of tile (tx, ty), in tile coordinates
+    float tile_far(int tx, int ty) { return tilefar_[tx + ty * tilesx_]; }
+
+    // recompute the depth ranges after pixels of a block or tile were written
+    void update_block(int bx, int by);
+    void update_tile(int tx, int ty);
+};
+
+#endif //__ZBUFFER_H__